@@ -0,0 +1,241 @@
+#include "BodyIntegrator.h"
+#include "RigidBody.h"
+#include <math.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define BODY_INTEGRATOR_X86
+#include <emmintrin.h>
+#endif
+
+// the state of the bodies, one array per component, padded to a multiple of 4 bodies
+enum BodyArray {
+    X, Y, Z, VX, VY, VZ,
+    QX, QY, QZ, QW,
+    WX, WY, WZ, LX, LY, LZ,
+    A00, A01, A02, A10, A11, A12, A20, A21, A22,    // principal axes (columns), body frame
+    I1, I2, I3,                                     // principal moments
+    R00, R01, R02, R10, R11, R12, R20, R21, R22,
+    II00, II01, II02, II11, II12, II22,             // IInv, symmetric
+    NUM_BODY_ARRAYS
+};
+
+// The update is written once, as a template over how many bodies a value holds: Scalar is one
+// body per float, Sse four per register. Both supply load/store, arithmetic, sqrt, sincos and
+// divOrZero (n / d where d > 0, else 0).
+
+struct Scalar {
+    enum { WIDTH = 1 };
+    typedef float F;
+    static F load(const float* p) { return *p; }
+    static void store(float* p, F v) { *p = v; }
+    static F set(float s) { return s; }
+    static F sqrt(F x) { return sqrtf(x); }
+    static F divOrZero(F n, F d) { return d > 0.f ? n / d : 0.f; }
+    static void sincos(F x, F* s, F* c) { *s = sinf(x); *c = cosf(x); }
+};
+
+#ifdef BODY_INTEGRATOR_X86
+// __m128 with operators (MSVC has none for it)
+struct Vec4 {
+    Vec4() {}
+    Vec4(__m128 v) : v(v) {}
+    __m128 v;
+};
+static inline Vec4 operator+(Vec4 a, Vec4 b) { return _mm_add_ps(a.v, b.v); }
+static inline Vec4 operator-(Vec4 a, Vec4 b) { return _mm_sub_ps(a.v, b.v); }
+static inline Vec4 operator*(Vec4 a, Vec4 b) { return _mm_mul_ps(a.v, b.v); }
+static inline Vec4 operator/(Vec4 a, Vec4 b) { return _mm_div_ps(a.v, b.v); }
+static inline Vec4 operator-(Vec4 a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.f)); }
+
+struct Sse {
+    enum { WIDTH = 4 };
+    typedef Vec4 F;
+    static F load(const float* p) { return _mm_load_ps(p); }
+    static void store(float* p, F v) { _mm_store_ps(p, v.v); }
+    static F set(float s) { return _mm_set1_ps(s); }
+    static F sqrt(F x) { return _mm_sqrt_ps(x.v); }
+    static F divOrZero(F n, F d) {
+        // 0 / 0 is NaN, but the mask clears it
+        return _mm_and_ps(_mm_cmpgt_ps(d.v, _mm_setzero_ps()), _mm_div_ps(n.v, d.v));
+    }
+    // x = k pi + r with |r| <= pi / 2, then Taylor series for sin r and cos r (error below 1e-7
+    // on that range); sin x = (-1)^k sin r, cos x = (-1)^k cos r
+    static void sincos(F x, F* s, F* c) {
+        __m128i k = _mm_cvtps_epi32(_mm_mul_ps(x.v, _mm_set1_ps(0.318309886f)));
+        __m128 kf = _mm_cvtepi32_ps(k);
+        // pi in two parts so k pi is subtracted without losing r's low bits
+        __m128 r = _mm_sub_ps(x.v, _mm_mul_ps(kf, _mm_set1_ps(3.140625f)));
+        r = _mm_sub_ps(r, _mm_mul_ps(kf, _mm_set1_ps(9.67653589793e-4f)));
+        F r2 = _mm_mul_ps(r, r);
+        F sinR = F(r) * (set(1.f) + r2 * (set(-1.f / 6.f) + r2 * (set(1.f / 120.f) + r2 * (set(-1.f / 5040.f) +
+                 r2 * (set(1.f / 362880.f) + r2 * set(-1.f / 39916800.f))))));
+        F cosR = set(1.f) + r2 * (set(-0.5f) + r2 * (set(1.f / 24.f) + r2 * (set(-1.f / 720.f) +
+                 r2 * (set(1.f / 40320.f) + r2 * (set(-1.f / 3628800.f) + r2 * set(1.f / 479001600.f))))));
+        __m128 sign = _mm_castsi128_ps(_mm_slli_epi32(k, 31));
+        *s = _mm_xor_ps(sinR.v, sign);
+        *c = _mm_xor_ps(cosR.v, sign);
+    }
+};
+#endif
+
+// step(dt) then stepW(dt) for the bodies at [i, i + L::WIDTH) of the arrays
+template <class L>
+static void integrateLanes(AlignedFloats* a, int i, float dt) {
+    typedef typename L::F F;
+#define LOAD(n) L::load(&a[n][i])
+#define STORE(n, v) L::store(&a[n][i], v)
+    const F dtv = L::set(dt);
+
+    // step: x += dt v
+    STORE(X, LOAD(X) + dtv * LOAD(VX));
+    STORE(Y, LOAD(Y) + dtv * LOAD(VY));
+    STORE(Z, LOAD(Z) + dtv * LOAD(VZ));
+
+    // q rotated by |w| dt about w: dq = (sin(|w| dt / 2) w / |w|, cos(|w| dt / 2)), and
+    // exactly the identity when w = 0
+    F wx = LOAD(WX), wy = LOAD(WY), wz = LOAD(WZ);
+    F wMag = L::sqrt(wx * wx + wy * wy + wz * wz);
+    F sinHalf, cosHalf;
+    L::sincos(L::set(0.5f * dt) * wMag, &sinHalf, &cosHalf);
+    F k = L::divOrZero(sinHalf, wMag);
+    F dx = k * wx, dy = k * wy, dz = k * wz, dw = cosHalf;
+
+    // q *= dq as openFrameworks multiplies (dq q in the usual order), then normalized
+    F qx = LOAD(QX), qy = LOAD(QY), qz = LOAD(QZ), qw = LOAD(QW);
+    F nx = dw * qx + dx * qw + dy * qz - dz * qy;
+    F ny = dw * qy - dx * qz + dy * qw + dz * qx;
+    F nz = dw * qz + dx * qy - dy * qx + dz * qw;
+    F nw = dw * qw - dx * qx - dy * qy - dz * qz;
+    F qLen = L::sqrt(nx * nx + ny * ny + nz * nz + nw * nw);
+    qx = nx / qLen;
+    qy = ny / qLen;
+    qz = nz / qLen;
+    qw = nw / qLen;
+    STORE(QX, qx);
+    STORE(QY, qy);
+    STORE(QZ, qz);
+    STORE(QW, qw);
+
+    // R from q, as ofMatrix3x3::setRotate
+    const F one = L::set(1.f), two = L::set(2.f);
+    F r00 = one - two * (qy * qy + qz * qz), r01 = two * (qx * qy - qz * qw), r02 = two * (qx * qz + qy * qw);
+    F r10 = two * (qx * qy + qz * qw), r11 = one - two * (qx * qx + qz * qz), r12 = two * (qy * qz - qx * qw);
+    F r20 = two * (qx * qz - qy * qw), r21 = two * (qy * qz + qx * qw), r22 = one - two * (qx * qx + qy * qy);
+    STORE(R00, r00); STORE(R01, r01); STORE(R02, r02);
+    STORE(R10, r10); STORE(R11, r11); STORE(R12, r12);
+    STORE(R20, r20); STORE(R21, r21); STORE(R22, r22);
+
+    // B = R A: the principal axes in the world
+    F a00 = LOAD(A00), a01 = LOAD(A01), a02 = LOAD(A02);
+    F a10 = LOAD(A10), a11 = LOAD(A11), a12 = LOAD(A12);
+    F a20 = LOAD(A20), a21 = LOAD(A21), a22 = LOAD(A22);
+    F b00 = r00 * a00 + r01 * a10 + r02 * a20, b01 = r00 * a01 + r01 * a11 + r02 * a21, b02 = r00 * a02 + r01 * a12 + r02 * a22;
+    F b10 = r10 * a00 + r11 * a10 + r12 * a20, b11 = r10 * a01 + r11 * a11 + r12 * a21, b12 = r10 * a02 + r11 * a12 + r12 * a22;
+    F b20 = r20 * a00 + r21 * a10 + r22 * a20, b21 = r20 * a01 + r21 * a11 + r22 * a21, b22 = r20 * a02 + r21 * a12 + r22 * a22;
+
+    // IInv = B diag(1 / I) B^T, and w = IInv L
+    F i1 = LOAD(I1), i2 = LOAD(I2), i3 = LOAD(I3);
+    F inv1 = one / i1, inv2 = one / i2, inv3 = one / i3;
+    F ii00 = b00 * b00 * inv1 + b01 * b01 * inv2 + b02 * b02 * inv3;
+    F ii01 = b00 * b10 * inv1 + b01 * b11 * inv2 + b02 * b12 * inv3;
+    F ii02 = b00 * b20 * inv1 + b01 * b21 * inv2 + b02 * b22 * inv3;
+    F ii11 = b10 * b10 * inv1 + b11 * b11 * inv2 + b12 * b12 * inv3;
+    F ii12 = b10 * b20 * inv1 + b11 * b21 * inv2 + b12 * b22 * inv3;
+    F ii22 = b20 * b20 * inv1 + b21 * b21 * inv2 + b22 * b22 * inv3;
+    STORE(II00, ii00); STORE(II01, ii01); STORE(II02, ii02);
+    STORE(II11, ii11); STORE(II12, ii12); STORE(II22, ii22);
+    F lx = LOAD(LX), ly = LOAD(LY), lz = LOAD(LZ);
+    wx = ii00 * lx + ii01 * ly + ii02 * lz;
+    wy = ii01 * lx + ii11 * ly + ii12 * lz;
+    wz = ii02 * lx + ii12 * ly + ii22 * lz;
+
+    // stepW: Euler's equations in the principal frame, one backward step. With w in that frame,
+    //   | I1/dt      (I3-I2)w3  0         |         | I1 w1/dt |
+    //   | 0          I2/dt      (I1-I3)w1 | w'  =   | I2 w2/dt |
+    //   | (I2-I1)w2  0          I3/dt     |         | I3 w3/dt |
+    // solved by Cramer's rule
+    F w1 = b00 * wx + b10 * wy + b20 * wz;
+    F w2 = b01 * wx + b11 * wy + b21 * wz;
+    F w3 = b02 * wx + b12 * wy + b22 * wz;
+    F invDt = L::set(1.f / dt);
+    F m0 = i1 * invDt, m1 = i2 * invDt, m2 = i3 * invDt;
+    F p = (i3 - i2) * w3, r = (i1 - i3) * w1, s = (i2 - i1) * w2;
+    F c0 = m0 * w1, c1 = m1 * w2, c2 = m2 * w3;
+    F det = m0 * m1 * m2 + p * r * s;
+    F t = c1 * m2 - r * c2;
+    F v1 = (c0 * m1 * m2 - p * t) / det;
+    F v2 = (m0 * t + c0 * r * s) / det;
+    F v3 = (m0 * m1 * c2 + p * c1 * s - c0 * m1 * s) / det;
+
+    // back to the world
+    STORE(WX, b00 * v1 + b01 * v2 + b02 * v3);
+    STORE(WY, b10 * v1 + b11 * v2 + b12 * v3);
+    STORE(WZ, b20 * v1 + b21 * v2 + b22 * v3);
+#undef LOAD
+#undef STORE
+}
+
+const char* BodyIntegrator::kernelName() {
+#ifdef BODY_INTEGRATOR_X86
+    return "sse";
+#else
+    return "scalar";
+#endif
+}
+
+void BodyIntegrator::integrate(RigidBody* const* bodies, int numBodies, float dt) {
+    if (numBodies == 0) {
+        return;
+    }
+    const int padded = (numBodies + 3) & ~3;
+    arrays.resize(NUM_BODY_ARRAYS);
+    for (int k = 0; k < NUM_BODY_ARRAYS; k++) {
+        arrays[k].resize(padded);
+    }
+
+    for (int i = 0; i < padded; i++) {
+        // padding lanes step a resting unit body, which is harmless
+        const RigidBody* body = bodies[i < numBodies ? i : 0];
+        bool pad = (i >= numBodies);
+        const ofMatrix3x3& axes = body->asset->principalAxes;
+        for (int c = 0; c < 3; c++) {
+            arrays[X + c][i] = body->x[c];
+            arrays[VX + c][i] = pad ? 0.f : body->v[c];
+            arrays[WX + c][i] = pad ? 0.f : body->w[c];
+            arrays[LX + c][i] = pad ? 0.f : body->L[c];
+            arrays[I1 + c][i] = body->IPrincipal[c];
+        }
+        arrays[QX][i] = body->q.x();
+        arrays[QY][i] = body->q.y();
+        arrays[QZ][i] = body->q.z();
+        arrays[QW][i] = body->q.w();
+        const float a[9] = { axes.a, axes.b, axes.c, axes.d, axes.e, axes.f, axes.g, axes.h, axes.i };
+        for (int e = 0; e < 9; e++) {
+            arrays[A00 + e][i] = a[e];
+        }
+    }
+
+    int lane = 0;
+#ifdef BODY_INTEGRATOR_X86
+    for (; lane < padded; lane += Sse::WIDTH) {
+        integrateLanes<Sse>(&arrays[0], lane, dt);
+    }
+#endif
+    for (; lane < numBodies; lane += Scalar::WIDTH) {
+        integrateLanes<Scalar>(&arrays[0], lane, dt);
+    }
+
+    for (int i = 0; i < numBodies; i++) {
+        RigidBody& body = *bodies[i];
+        body.x = ofVec3f(arrays[X][i], arrays[Y][i], arrays[Z][i]);
+        body.q = ofQuaternion(arrays[QX][i], arrays[QY][i], arrays[QZ][i], arrays[QW][i]);
+        for (int e = 0; e < 9; e++) {
+            body.R[e] = arrays[R00 + e][i];
+        }
+        body.RInv = body.R.transposed();
+        body.IInv = ofMatrix3x3(arrays[II00][i], arrays[II01][i], arrays[II02][i],
+                                arrays[II01][i], arrays[II11][i], arrays[II12][i],
+                                arrays[II02][i], arrays[II12][i], arrays[II22][i]);
+        body.w = ofVec3f(arrays[WX][i], arrays[WY][i], arrays[WZ][i]);
+    }
+}
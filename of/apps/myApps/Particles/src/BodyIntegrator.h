@@ -0,0 +1,29 @@
+#ifndef BODYINTEGRATOR_H
+#define BODYINTEGRATOR_H
+
+#include <vector>
+#include "ModalBank.h"
+
+struct RigidBody;
+
+// Advances many rigid bodies at once, with the same result as calling step(dt) and then
+// stepW(dt) on each (to float rounding). The state the two need is copied into one array per
+// component, the update runs over those arrays four bodies to an SSE register, and the results
+// are copied back.
+// The world inertia is rebuilt from the principal frame, IInv = (R A) diag(1/I) (R A)^T, so
+// both steps share one matrix product, and stepW's 3x3 system is solved in closed form. A body
+// with no angular velocity keeps its orientation exactly.
+class BodyIntegrator {
+public:
+    BodyIntegrator() {}
+
+    void integrate(RigidBody* const* bodies, int numBodies, float dt);
+
+    // "sse" or "scalar"
+    static const char* kernelName();
+
+private:
+    std::vector<AlignedFloats> arrays;  // one per component of the state, see the .cpp
+};
+
+#endif
@@ -0,0 +1,29 @@
+#include "CollisionQueue.h"
+#include <algorithm>
+
+using namespace std;
+
+void CollisionQueue::clear(int numSpheres) {
+    events.clear();
+    versions.assign(numSpheres, 0);
+}
+
+void CollisionQueue::push(float t, int i, int j) {
+    events.push_back(Event(t, i, j, versions[i], j >= 0 ? versions[j] : 0));
+    push_heap(events.begin(), events.end());
+}
+
+bool CollisionQueue::pop(float* t, int* i, int* j) {
+    while (!events.empty()) {
+        pop_heap(events.begin(), events.end());
+        Event e = events.back();
+        events.pop_back();
+        if (e.iVersion == versions[e.i] && (e.j < 0 || e.jVersion == versions[e.j])) {
+            *t = e.t;
+            *i = e.i;
+            *j = e.j;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,47 @@
+#ifndef COLLISIONQUEUE_H
+#define COLLISIONQUEUE_H
+
+#include <vector>
+
+// Predicted collisions of the spheres over a frame, earliest first. Each sphere has a version
+// that goes up whenever its path changes; an event remembers the versions of its spheres when it
+// was predicted, and is dropped when popped if either has changed since. So after an impact only
+// the events of the spheres hit need predicting again.
+class CollisionQueue {
+public:
+    CollisionQueue() {}
+
+    // empties the queue for a frame with numSpheres spheres
+    void clear(int numSpheres);
+
+    // sphere i hits sphere j (j >= 0) or wall j (j < 0) at time t
+    void push(float t, int i, int j);
+
+    // sphere i's path changed: the events it is in are stale
+    void invalidate(int i) { versions[i]++; }
+
+    // the earliest event that isn't stale; returns false if there is none
+    bool pop(float* t, int* i, int* j);
+
+    int size() const { return (int)events.size(); }
+
+private:
+    struct Event {
+        Event(float t, int i, int j, unsigned int iVersion, unsigned int jVersion)
+            : t(t), i(i), j(j), iVersion(iVersion), jVersion(jVersion) {}
+        // a max-heap on this gives the earliest event; ties go to the lowest spheres
+        bool operator<(const Event& e) const {
+            return t > e.t || (t == e.t && (i > e.i || (i == e.i && j > e.j)));
+        }
+        float t;
+        int i;
+        int j;
+        unsigned int iVersion;
+        unsigned int jVersion;
+    };
+
+    std::vector<Event> events;  // heap
+    std::vector<unsigned int> versions;
+};
+
+#endif
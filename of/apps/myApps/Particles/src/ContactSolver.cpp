@@ -0,0 +1,49 @@
+#include "ContactSolver.h"
+#include <algorithm>
+
+using namespace std;
+
+int solveContacts(RigidBody& body, vector<Contact>& contacts, int maxIterations,
+                  vector<VertexImpulse>* impulses) {
+    if (contacts.empty()) {
+        return 0;
+    }
+    for (int c = 0; c < contacts.size(); c++) {
+        Contact& contact = contacts[c];
+        contact.k = 1.f / body.m + ((body.IInv * (contact.r.crossed(contact.n))).crossed(contact.r)).dot(contact.n);
+        contact.impulse = 0.f;
+    }
+
+    int iteration = 0;
+    while (iteration < maxIterations) {
+        iteration++;
+        float maxChange = 0.f;
+        float maxImpulse = 0.f;
+        for (int c = 0; c < contacts.size(); c++) {
+            Contact& contact = contacts[c];
+            float speed = (body.v + body.w.crossed(contact.r)).dot(contact.n);
+            float impulse = max(contact.impulse + (contact.targetSpeed - speed) / contact.k, 0.f);
+            float change = impulse - contact.impulse;
+            contact.impulse = impulse;
+            if (change != 0.f) {
+                ofVec3f j = change * contact.n;
+                body.P += j;
+                body.L += contact.r.crossed(j);
+                body.v = body.P / body.m;
+                body.w = body.IInv * body.L;
+            }
+            maxChange = max(maxChange, fabsf(change));
+            maxImpulse = max(maxImpulse, impulse);
+        }
+        if (maxChange <= 1e-4f * maxImpulse) {
+            break;
+        }
+    }
+
+    for (int c = 0; c < contacts.size(); c++) {
+        if (contacts[c].impulse > 0.f) {
+            impulses->emplace_back(contacts[c].vertex, contacts[c].impulse * contacts[c].n);
+        }
+    }
+    return iteration;
+}
@@ -0,0 +1,31 @@
+#ifndef CONTACTSOLVER_H
+#define CONTACTSOLVER_H
+
+#include <vector>
+#include "RigidBody.h"
+
+#include "ofMain.h"
+
+// A vertex of a body that is close enough to an immovable plane to reach it this frame.
+struct Contact {
+    Contact(int vertex, const ofVec3f& r, const ofVec3f& n, float targetSpeed)
+        : vertex(vertex), r(r), n(n), targetSpeed(targetSpeed), k(0.f), impulse(0.f) {}
+    int vertex;
+    ofVec3f r;              // world offset of the vertex from the body's center of mass
+    ofVec3f n;              // plane normal, pointing away from the plane towards the body
+    float targetSpeed;      // least speed along n the vertex may leave with; negative lets it
+                            // keep approaching that fast
+    float k;                // speed along n one unit of impulse along n gives the vertex
+    float impulse;          // accumulated impulse along n
+};
+
+// Resolves all the contacts of a body at once with sequential impulses. Each iteration goes
+// through the contacts in turn and applies the impulse that brings the vertex up to its
+// target speed, with each contact's accumulated impulse kept >= 0 (a plane can only push).
+// Stops after maxIterations, or once no contact's impulse changes by more than a small part of
+// the largest one. P, L, v and w of the body are updated, and a VertexImpulse is appended for
+// every contact that pushed. Returns the number of iterations run.
+int solveContacts(RigidBody& body, std::vector<Contact>& contacts, int maxIterations,
+                  std::vector<VertexImpulse>* impulses);
+
+#endif
@@ -0,0 +1,315 @@
+#include "ConvexHull.h"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+// A triangle of the hull being built, counterclockwise seen from outside.
+// Whether a point is above a face is decided by the sign of normal . (p - v[0]) with the
+// unnormalized normal: with float input, the differences and the cross product are exact in
+// double, so the test only fails for points within rounding error of the plane. (A normalized
+// normal with a tolerance goes wrong on sliver faces, which fine meshes are full of.)
+struct HullFace {
+    int v[3];
+    int neighbor[3];            // face across the edge v[i] -> v[(i + 1) % 3]
+    Eigen::Vector3d normal;     // (v1 - v0) x (v2 - v0), outward
+    vector<int> outside;        // points above the face, not yet processed
+    bool dead;
+    int visitedRound;           // last round the face was tested for visibility
+    bool visible;               // the result of that test
+
+    // positive above the face; |normal| times the distance from its plane
+    double height(const vector<Eigen::Vector3d>& p, int i) const { return normal.dot(p[i] - p[v[0]]); }
+};
+
+static HullFace makeFace(const vector<Eigen::Vector3d>& p, int a, int b, int c) {
+    HullFace face;
+    face.v[0] = a;
+    face.v[1] = b;
+    face.v[2] = c;
+    face.neighbor[0] = face.neighbor[1] = face.neighbor[2] = -1;
+    face.normal = (p[b] - p[a]).cross(p[c] - p[a]);
+    face.dead = false;
+    face.visitedRound = -1;
+    face.visible = false;
+    return face;
+}
+
+void ConvexHull::build(const ofVec3f* points, int numPoints) {
+    vertices.clear();
+    positions.clear();
+    neighborOffsets.assign(1, 0);
+    neighbors.clear();
+    if (numPoints == 0) {
+        return;
+    }
+
+    vector<Eigen::Vector3d> p(numPoints);
+    double scale = 0.0;
+    for (int i = 0; i < numPoints; i++) {
+        p[i] = Eigen::Vector3d(points[i].x, points[i].y, points[i].z);
+        scale = max(scale, p[i].cwiseAbs().maxCoeff());
+    }
+    const double flatEps = 1e-6 * scale;        // a thinner point set is treated as flat
+
+    // initial tetrahedron: the two furthest apart of the extreme points along the axes, the
+    // point furthest from the line through them, and the point furthest from that plane
+    int extremes[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int i = 0; i < numPoints; i++) {
+        for (int c = 0; c < 3; c++) {
+            if (p[i][c] < p[extremes[2 * c]][c]) extremes[2 * c] = i;
+            if (p[i][c] > p[extremes[2 * c + 1]][c]) extremes[2 * c + 1] = i;
+        }
+    }
+    int i0 = 0, i1 = 0;
+    double maxDistSq = -1.0;
+    for (int j = 0; j < 6; j++) {
+        for (int k = j + 1; k < 6; k++) {
+            double distSq = (p[extremes[j]] - p[extremes[k]]).squaredNorm();
+            if (distSq > maxDistSq) {
+                maxDistSq = distSq;
+                i0 = extremes[j];
+                i1 = extremes[k];
+            }
+        }
+    }
+    Eigen::Vector3d lineDir = (p[i1] - p[i0]).normalized();
+    int i2 = i0;
+    double maxDist = 0.0;
+    for (int i = 0; i < numPoints; i++) {
+        double dist = (p[i] - p[i0]).cross(lineDir).norm();
+        if (dist > maxDist) {
+            maxDist = dist;
+            i2 = i;
+        }
+    }
+    bool flat = (sqrt(maxDistSq) <= flatEps || maxDist <= flatEps);
+    int i3 = i0;
+    if (!flat) {
+        Eigen::Vector3d planeNormal = (p[i1] - p[i0]).cross(p[i2] - p[i0]).normalized();
+        maxDist = 0.0;
+        for (int i = 0; i < numPoints; i++) {
+            double dist = fabs(planeNormal.dot(p[i] - p[i0]));
+            if (dist > maxDist) {
+                maxDist = dist;
+                i3 = i;
+            }
+        }
+        flat = (maxDist <= flatEps);
+    }
+    if (flat) {
+        // no volume to walk over: every point is a candidate
+        vertices.resize(numPoints);
+        positions.assign(points, points + numPoints);
+        for (int i = 0; i < numPoints; i++) {
+            vertices[i] = i;
+        }
+        neighborOffsets.assign(numPoints + 1, 0);
+        return;
+    }
+
+    vector<HullFace> faces;
+    const int simplex[4][3] = { { i0, i1, i2 }, { i0, i3, i1 }, { i1, i3, i2 }, { i2, i3, i0 } };
+    const int opposite[4] = { i3, i2, i0, i1 };
+    for (int f = 0; f < 4; f++) {
+        HullFace face = makeFace(p, simplex[f][0], simplex[f][1], simplex[f][2]);
+        if (face.height(p, opposite[f]) > 0.0) {
+            face = makeFace(p, simplex[f][0], simplex[f][2], simplex[f][1]);
+        }
+        faces.push_back(face);
+    }
+    for (int f = 0; f < 4; f++) {
+        for (int e = 0; e < 3; e++) {
+            int a = faces[f].v[e], b = faces[f].v[(e + 1) % 3];
+            for (int g = 0; g < 4; g++) {
+                for (int k = 0; k < 3; k++) {
+                    if (g != f && faces[g].v[k] == b && faces[g].v[(k + 1) % 3] == a) {
+                        faces[f].neighbor[e] = g;
+                    }
+                }
+            }
+        }
+    }
+    for (int i = 0; i < numPoints; i++) {
+        if (i == i0 || i == i1 || i == i2 || i == i3) {
+            continue;
+        }
+        for (int f = 0; f < 4; f++) {
+            if (faces[f].height(p, i) > 0.0) {
+                faces[f].outside.push_back(i);
+                break;
+            }
+        }
+    }
+
+    // Add the furthest outside point of each face in turn: the faces it sees are replaced by a
+    // cone of faces from the horizon around them to the point. New faces go on the end of
+    // the list, so one pass reaches all of them.
+    vector<int> coneFaceFrom(numPoints, -1);    // new face whose horizon edge starts at a point
+    vector<int> stack, visibleFaces, orphans;
+    vector<int> horizonFace, horizonEdge;
+    int round = 0;
+    for (int f = 0; f < faces.size(); f++) {
+        if (faces[f].dead || faces[f].outside.empty()) {
+            continue;
+        }
+        int eye = faces[f].outside[0];
+        double eyeHeight = faces[f].height(p, eye);
+        for (int k = 1; k < faces[f].outside.size(); k++) {
+            double height = faces[f].height(p, faces[f].outside[k]);
+            if (height > eyeHeight) {
+                eyeHeight = height;
+                eye = faces[f].outside[k];
+            }
+        }
+
+        // the faces the eye sees, and the edges between them and the rest
+        round++;
+        visibleFaces.clear();
+        horizonFace.clear();
+        horizonEdge.clear();
+        faces[f].visitedRound = round;
+        faces[f].visible = true;
+        stack.assign(1, f);
+        while (!stack.empty()) {
+            int g = stack.back();
+            stack.pop_back();
+            visibleFaces.push_back(g);
+            for (int e = 0; e < 3; e++) {
+                HullFace& neighbor = faces[faces[g].neighbor[e]];
+                if (neighbor.visitedRound != round) {
+                    neighbor.visitedRound = round;
+                    neighbor.visible = (neighbor.height(p, eye) > 0.0);
+                    if (neighbor.visible) {
+                        stack.push_back(faces[g].neighbor[e]);
+                    }
+                }
+                if (!neighbor.visible) {
+                    horizonFace.push_back(g);
+                    horizonEdge.push_back(e);
+                }
+            }
+        }
+
+        // the cone: one face (a, b, eye) for each horizon edge a -> b
+        int firstNewFace = faces.size();
+        for (int k = 0; k < horizonFace.size(); k++) {
+            const HullFace& visible = faces[horizonFace[k]];
+            int e = horizonEdge[k];
+            int a = visible.v[e], b = visible.v[(e + 1) % 3];
+            int outer = visible.neighbor[e];
+            HullFace face = makeFace(p, a, b, eye);
+            face.neighbor[0] = outer;
+            for (int j = 0; j < 3; j++) {
+                if (faces[outer].v[j] == b && faces[outer].v[(j + 1) % 3] == a) {
+                    faces[outer].neighbor[j] = faces.size();
+                }
+            }
+            coneFaceFrom[a] = faces.size();
+            faces.push_back(face);
+        }
+        for (int g = firstNewFace; g < faces.size(); g++) {
+            // b -> eye is eye -> b of the next face around the cone, eye -> a is a -> eye of
+            // the one before
+            HullFace& face = faces[g];
+            face.neighbor[1] = coneFaceFrom[face.v[1]];
+            faces[face.neighbor[1]].neighbor[2] = g;
+        }
+        for (int g = firstNewFace; g < faces.size(); g++) {
+            coneFaceFrom[faces[g].v[0]] = -1;
+        }
+
+        // hand the outside points of the faces that are gone to the new ones
+        orphans.clear();
+        for (int k = 0; k < visibleFaces.size(); k++) {
+            HullFace& visible = faces[visibleFaces[k]];
+            visible.dead = true;
+            orphans.insert(orphans.end(), visible.outside.begin(), visible.outside.end());
+            vector<int>().swap(visible.outside);
+        }
+        for (int k = 0; k < orphans.size(); k++) {
+            int i = orphans[k];
+            if (i == eye) {
+                continue;
+            }
+            for (int g = firstNewFace; g < faces.size(); g++) {
+                if (faces[g].height(p, i) > 0.0) {
+                    faces[g].outside.push_back(i);
+                    break;
+                }
+            }
+        }
+    }
+
+    // hull vertices and edges; every edge a -> b of a face is b -> a in its neighbor, so
+    // taking the edges of each face one way gives every edge once in each direction
+    vector<int> hullIndex(numPoints, -1);
+    vector<int> degree;
+    for (int f = 0; f < faces.size(); f++) {
+        if (faces[f].dead) {
+            continue;
+        }
+        for (int e = 0; e < 3; e++) {
+            int a = faces[f].v[e];
+            if (hullIndex[a] < 0) {
+                hullIndex[a] = vertices.size();
+                vertices.push_back(a);
+                positions.push_back(points[a]);
+                degree.push_back(0);
+            }
+            degree[hullIndex[a]]++;
+        }
+    }
+    neighborOffsets.assign(vertices.size() + 1, 0);
+    for (int h = 0; h < vertices.size(); h++) {
+        neighborOffsets[h + 1] = neighborOffsets[h] + degree[h];
+    }
+    neighbors.resize(neighborOffsets.back());
+    vector<int> filled(neighborOffsets.begin(), neighborOffsets.end() - 1);
+    for (int f = 0; f < faces.size(); f++) {
+        if (faces[f].dead) {
+            continue;
+        }
+        for (int e = 0; e < 3; e++) {
+            int a = hullIndex[faces[f].v[e]];
+            int b = hullIndex[faces[f].v[(e + 1) % 3]];
+            neighbors[filled[a]++] = b;
+        }
+    }
+}
+
+int ConvexHull::support(const ofVec3f& dir, int* hint) const {
+    if (vertices.empty()) {
+        return -1;
+    }
+    int h = (0 <= *hint && *hint < numVertices()) ? *hint : 0;
+    float best = positions[h].dot(dir);
+    if (neighbors.empty()) {
+        for (int k = 0; k < numVertices(); k++) {
+            float d = positions[k].dot(dir);
+            if (d > best) {
+                best = d;
+                h = k;
+            }
+        }
+    } else {
+        // on a convex polytope any vertex with no better neighbor is the furthest one
+        while (true) {
+            int next = h;
+            for (const int* n = neighborsBegin(h); n != neighborsEnd(h); n++) {
+                float d = positions[*n].dot(dir);
+                if (d > best) {
+                    best = d;
+                    next = *n;
+                }
+            }
+            if (next == h) {
+                break;
+            }
+            h = next;
+        }
+    }
+    *hint = h;
+    return h;
+}
@@ -0,0 +1,41 @@
+#ifndef CONVEXHULL_H
+#define CONVEXHULL_H
+
+#include <vector>
+
+#include "ofMain.h"
+
+// The vertices of the convex hull of a point set and the hull edges between them, for support
+// queries: the point furthest along a direction is found by walking the hull edges uphill,
+// which touches a handful of vertices instead of all of them.
+class ConvexHull {
+public:
+    ConvexHull() {}
+
+    // quickhull; if the points are all (nearly) coplanar every point is kept as a hull vertex
+    // with no edges, and support queries scan them all
+    void build(const ofVec3f* points, int numPoints);
+
+    int numVertices() const { return (int)vertices.size(); }
+    // no edges: the points were flat and every one is a hull vertex
+    bool isFlat() const { return neighbors.empty(); }
+    // index of hull vertex h in the points given to build
+    int vertex(int h) const { return vertices[h]; }
+    const ofVec3f& position(int h) const { return positions[h]; }
+
+    // hull vertices joined to hull vertex h by an edge
+    const int* neighborsBegin(int h) const { return neighbors.data() + neighborOffsets[h]; }
+    const int* neighborsEnd(int h) const { return neighbors.data() + neighborOffsets[h + 1]; }
+
+    // the hull vertex furthest along dir, searching from hull vertex *hint; *hint is set to the
+    // result so the next search for a similar direction starts next to it. returns -1 if empty.
+    int support(const ofVec3f& dir, int* hint) const;
+
+private:
+    std::vector<int> vertices;
+    std::vector<ofVec3f> positions;
+    std::vector<int> neighborOffsets;   // numVertices() + 1 entries
+    std::vector<int> neighbors;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include "KdTree.h"
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+// orders point indices by one coordinate
+struct CoordinateLess {
+    CoordinateLess(const ofVec3f* points, int axis) : points(points), axis(axis) {}
+    bool operator()(int i, int j) const { return points[i][axis] < points[j][axis]; }
+    const ofVec3f* points;
+    int axis;
+};
+
+void KdTree::build(const ofVec3f* inputPoints, int numPoints) {
+    pointIndex.resize(numPoints);
+    for (int i = 0; i < numPoints; i++) {
+        pointIndex[i] = i;
+    }
+    points.assign(inputPoints, inputPoints + numPoints);
+    splitAxis.assign(numPoints, 0);
+    buildRange(0, numPoints);
+
+    // reorder the points so queries walk through them in memory order
+    for (int i = 0; i < numPoints; i++) {
+        points[i] = inputPoints[pointIndex[i]];
+    }
+}
+
+void KdTree::buildRange(int begin, int end) {
+    if (end - begin <= LEAF_SIZE) {
+        return;
+    }
+    // split along the longest side of the bounding box
+    ofVec3f lo = points[pointIndex[begin]], hi = lo;
+    for (int i = begin + 1; i < end; i++) {
+        const ofVec3f& point = points[pointIndex[i]];
+        for (int c = 0; c < 3; c++) {
+            lo[c] = min(lo[c], point[c]);
+            hi[c] = max(hi[c], point[c]);
+        }
+    }
+    ofVec3f extent = hi - lo;
+    int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+    int middle = (begin + end) / 2;
+    nth_element(pointIndex.begin() + begin, pointIndex.begin() + middle, pointIndex.begin() + end,
+                CoordinateLess(&points[0], axis));
+    splitAxis[middle] = (unsigned char)axis;
+    buildRange(begin, middle);
+    buildRange(middle + 1, end);
+}
+
+int KdTree::nearest(const ofVec3f& p) const {
+    Candidate best(numeric_limits<float>::max(), -1);
+    searchNearest(0, size(), p, &best);
+    return best.index;
+}
+
+void KdTree::searchNearest(int begin, int end, const ofVec3f& p, Candidate* best) const {
+    if (end - begin <= LEAF_SIZE) {
+        for (int i = begin; i < end; i++) {
+            Candidate candidate((points[i] - p).lengthSquared(), pointIndex[i]);
+            if (candidate < *best) {
+                *best = candidate;
+            }
+        }
+        return;
+    }
+    int middle = (begin + end) / 2;
+    Candidate candidate((points[middle] - p).lengthSquared(), pointIndex[middle]);
+    if (candidate < *best) {
+        *best = candidate;
+    }
+    // the near side first; the far side only if it can hold a point at least as close
+    float d = p[splitAxis[middle]] - points[middle][splitAxis[middle]];
+    if (d < 0.f) {
+        searchNearest(begin, middle, p, best);
+        if (d * d <= best->distSq) {
+            searchNearest(middle + 1, end, p, best);
+        }
+    } else {
+        searchNearest(middle + 1, end, p, best);
+        if (d * d <= best->distSq) {
+            searchNearest(begin, middle, p, best);
+        }
+    }
+}
+
+void KdTree::nearest(const ofVec3f& p, int k, vector<int>* indices) const {
+    // max-heap of the k closest points found so far
+    vector<Candidate> heap;
+    k = min(k, size());
+    if (k > 0) {
+        heap.reserve(k);
+        searchNearest(0, size(), p, k, &heap);
+    }
+    sort_heap(heap.begin(), heap.end());
+    indices->resize(heap.size());
+    for (int i = 0; i < heap.size(); i++) {
+        (*indices)[i] = heap[i].index;
+    }
+}
+
+void KdTree::searchNearest(int begin, int end, const ofVec3f& p, int k, vector<Candidate>* heap) const {
+    int middle = (begin + end) / 2;
+    bool leaf = (end - begin <= LEAF_SIZE);
+    for (int i = (leaf ? begin : middle); i < (leaf ? end : middle + 1); i++) {
+        Candidate candidate((points[i] - p).lengthSquared(), pointIndex[i]);
+        if (heap->size() < k) {
+            heap->push_back(candidate);
+            push_heap(heap->begin(), heap->end());
+        } else if (candidate < heap->front()) {
+            pop_heap(heap->begin(), heap->end());
+            heap->back() = candidate;
+            push_heap(heap->begin(), heap->end());
+        }
+    }
+    if (leaf) {
+        return;
+    }
+    float d = p[splitAxis[middle]] - points[middle][splitAxis[middle]];
+    int nearBegin = (d < 0.f) ? begin : middle + 1;
+    int nearEnd = (d < 0.f) ? middle : end;
+    int farBegin = (d < 0.f) ? middle + 1 : begin;
+    int farEnd = (d < 0.f) ? end : middle;
+    searchNearest(nearBegin, nearEnd, p, k, heap);
+    if (heap->size() < k || d * d <= heap->front().distSq) {
+        searchNearest(farBegin, farEnd, p, k, heap);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef KDTREE_H
+#define KDTREE_H
+
+#include <vector>
+
+#include "ofMain.h"
+
+// A balanced k-d tree over a fixed set of points, for nearest-neighbour queries in O(log n).
+// Ties between equally close points go to the lowest index, as with a linear scan.
+class KdTree {
+public:
+    KdTree() {}
+
+    void build(const ofVec3f* points, int numPoints);
+
+    int size() const { return (int)pointIndex.size(); }
+
+    // index of the point closest to p, or -1 if there are no points
+    int nearest(const ofVec3f& p) const;
+
+    // indices of the min(k, size()) points closest to p, closest first
+    void nearest(const ofVec3f& p, int k, std::vector<int>* indices) const;
+
+private:
+    // A subtree is a range [begin, end) of the points. A range longer than LEAF_SIZE is split
+    // at its middle point along splitAxis[middle]: the points before the middle are on the low
+    // side of it and the points after on the high side.
+    enum { LEAF_SIZE = 8 };
+
+    // (squared distance, index) of a candidate point; compares like the linear scan
+    struct Candidate {
+        Candidate(float distSq, int index) : distSq(distSq), index(index) {}
+        bool operator<(const Candidate& other) const {
+            return distSq < other.distSq || (distSq == other.distSq && index < other.index);
+        }
+        float distSq;
+        int index;
+    };
+
+    void buildRange(int begin, int end);
+    void searchNearest(int begin, int end, const ofVec3f& p, Candidate* best) const;
+    void searchNearest(int begin, int end, const ofVec3f& p, int k, std::vector<Candidate>* heap) const;
+
+    std::vector<ofVec3f> points;        // in tree order
+    std::vector<int> pointIndex;        // index of each point as given to build
+    std::vector<unsigned char> splitAxis;
+};
+
+#endif
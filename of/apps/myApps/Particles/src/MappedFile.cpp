@@ -0,0 +1,157 @@
+#include "MappedFile.h"
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    :
+    data_(NULL),
+    size_(0),
+#ifdef _WIN32
+    file(INVALID_HANDLE_VALUE),
+    mapping(NULL)
+#else
+    fd(-1)
+#endif
+{}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& fileName) {
+    close();
+    file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        close();
+        return false;
+    }
+    data_ = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data_ == NULL) {
+        close();
+        return false;
+    }
+    size_ = (size_t)fileSize.QuadPart;
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_ != NULL) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping != NULL) {
+        CloseHandle(mapping);
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+    data_ = NULL;
+    size_ = 0;
+    mapping = NULL;
+    file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const std::string& fileName) {
+    close();
+    fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close();
+        return false;
+    }
+    void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        close();
+        return false;
+    }
+    data_ = (const char*)p;
+    size_ = (size_t)st.st_size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_ != NULL) {
+        munmap((void*)data_, size_);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    data_ = NULL;
+    size_ = 0;
+    fd = -1;
+}
+
+#endif
+
+long long fileModifiedTime(const std::string& fileName) {
+    struct stat st;
+    if (stat(fileName.c_str(), &st) != 0) {
+        return 0;
+    }
+    return (long long)st.st_mtime;
+}
+
+std::string replaceFileExtension(const std::string& fileName, const std::string& extension) {
+    size_t dot = fileName.find_last_of('.');
+    size_t slash = fileName.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return fileName + extension;
+    }
+    return fileName.substr(0, dot) + extension;
+}
+
+bool writeFileAtomically(const std::string& fileName, const std::vector<std::pair<const void*, size_t> >& blocks) {
+    std::string tmpFileName = fileName + ".tmp";
+    std::ofstream out(tmpFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cout << "Failed to create " << tmpFileName << std::endl;
+        return false;
+    }
+    for (size_t b = 0; b < blocks.size(); b++) {
+        if (blocks[b].second > 0) {
+            out.write((const char*)blocks[b].first, blocks[b].second);
+        }
+    }
+    out.close();
+    if (!out) {
+        std::cout << "Failed to write " << tmpFileName << std::endl;
+        remove(tmpFileName.c_str());
+        return false;
+    }
+    remove(fileName.c_str());
+    if (rename(tmpFileName.c_str(), fileName.c_str()) != 0) {
+        std::cout << "Failed to rename " << tmpFileName << " to " << fileName << std::endl;
+        remove(tmpFileName.c_str());
+        return false;
+    }
+    return true;
+}
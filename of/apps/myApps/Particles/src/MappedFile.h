@@ -0,0 +1,48 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stddef.h>
+
+// A read-only memory mapping of a whole file. Pages are loaded on demand by the OS and shared
+// between all processes that map the same file.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const std::string& fileName);
+    void close();
+
+    bool isOpen() const { return data_ != NULL; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char* data_;
+    size_t size_;
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#else
+    int fd;
+#endif
+};
+
+// modification time of a file, or 0 if it doesn't exist
+long long fileModifiedTime(const std::string& fileName);
+
+// fileName with its extension (if any) replaced by extension, e.g. ".bin"
+std::string replaceFileExtension(const std::string& fileName, const std::string& extension);
+
+// writes the blocks (pointer, byte count) one after another to fileName.tmp and then renames it
+// to fileName, so a reader never picks up a partly written file. reports and returns false on
+// failure, leaving no .tmp behind.
+bool writeFileAtomically(const std::string& fileName, const std::vector<std::pair<const void*, size_t> >& blocks);
+
+#endif
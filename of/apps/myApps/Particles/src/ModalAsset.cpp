@@ -0,0 +1,568 @@
+#include "ModalAsset.h"
+#include "ModesFile.h"
+#include "ObjFile.h"
+#include "WorkerPool.h"
+#include "redsvd/redsvd.hpp"
+#include <assert.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+// Integrals of 1, x, y, z, x^2, y^2, z^2, xy, yz, zx over the volume enclosed by a triangle
+// mesh, summed over the signed tetrahedra formed by each face and the origin.
+// http://www.geometrictools.com/Documentation/PolyhedralMassProperties.pdf
+struct VolumeIntegrals {
+    enum { ONE, X, Y, Z, XX, YY, ZZ, XY, YZ, ZX, COUNT };
+
+    VolumeIntegrals() {
+        for (int k = 0; k < COUNT; k++) {
+            intg[k] = 0.0;
+        }
+    }
+
+    void addTriangles(const ofVec3f* vertices, const ofIndexType* indices, int begin, int end) {
+        double sum[COUNT] = { 0.0 };
+        for (int t = begin; t < end; t++) {
+            const ofVec3f& v0 = vertices[indices[3 * t]];
+            const ofVec3f& v1 = vertices[indices[3 * t + 1]];
+            const ofVec3f& v2 = vertices[indices[3 * t + 2]];
+            double x0 = v0.x, y0 = v0.y, z0 = v0.z;
+            double x1 = v1.x, y1 = v1.y, z1 = v1.z;
+            double x2 = v2.x, y2 = v2.y, z2 = v2.z;
+
+            // normal (times twice the area)
+            double a1 = x1 - x0, b1 = y1 - y0, c1 = z1 - z0;
+            double a2 = x2 - x0, b2 = y2 - y0, c2 = z2 - z0;
+            double d0 = b1 * c2 - b2 * c1;
+            double d1 = a2 * c1 - a1 * c2;
+            double d2 = a1 * b2 - a2 * b1;
+
+            double f1x, f2x, f3x, g0x, g1x, g2x;
+            subexpressions(x0, x1, x2, &f1x, &f2x, &f3x, &g0x, &g1x, &g2x);
+            double f1y, f2y, f3y, g0y, g1y, g2y;
+            subexpressions(y0, y1, y2, &f1y, &f2y, &f3y, &g0y, &g1y, &g2y);
+            double f1z, f2z, f3z, g0z, g1z, g2z;
+            subexpressions(z0, z1, z2, &f1z, &f2z, &f3z, &g0z, &g1z, &g2z);
+
+            sum[ONE] += d0 * f1x;
+            sum[X] += d0 * f2x;
+            sum[Y] += d1 * f2y;
+            sum[Z] += d2 * f2z;
+            sum[XX] += d0 * f3x;
+            sum[YY] += d1 * f3y;
+            sum[ZZ] += d2 * f3z;
+            sum[XY] += d0 * (y0 * g0x + y1 * g1x + y2 * g2x);
+            sum[YZ] += d1 * (z0 * g0y + z1 * g1y + z2 * g2y);
+            sum[ZX] += d2 * (x0 * g0z + x1 * g1z + x2 * g2z);
+        }
+        static const double scale[COUNT] = {
+            1.0 / 6.0, 1.0 / 24.0, 1.0 / 24.0, 1.0 / 24.0,
+            1.0 / 60.0, 1.0 / 60.0, 1.0 / 60.0, 1.0 / 120.0, 1.0 / 120.0, 1.0 / 120.0
+        };
+        for (int k = 0; k < COUNT; k++) {
+            intg[k] += scale[k] * sum[k];
+        }
+    }
+
+    void add(const VolumeIntegrals& other) {
+        for (int k = 0; k < COUNT; k++) {
+            intg[k] += other.intg[k];
+        }
+    }
+
+    double intg[COUNT];
+
+private:
+    static void subexpressions(double w0, double w1, double w2,
+                               double* f1, double* f2, double* f3,
+                               double* g0, double* g1, double* g2) {
+        double temp0 = w0 + w1;
+        double temp1 = w0 * w0;
+        double temp2 = temp1 + w1 * temp0;
+        *f1 = temp0 + w2;
+        *f2 = temp2 + w2 * (*f1);
+        *f3 = w0 * temp1 + w1 * temp2 + w2 * (*f2);
+        *g0 = *f2 + w0 * (*f1 + w0);
+        *g1 = *f2 + w1 * (*f1 + w1);
+        *g2 = *f2 + w2 * (*f1 + w2);
+    }
+};
+
+// orders mode indices by ascending eigenvalue
+struct EigenValueLess {
+    EigenValueLess(const vector<float>& eigenValues) : eigenValues(eigenValues) {}
+    bool operator()(int i, int j) const { return eigenValues[i] < eigenValues[j]; }
+    const vector<float>& eigenValues;
+};
+
+// since the excitation of mode i is phi_i . F, its rms error over all vertices and force
+// directions relative to its rms excitation is |phi_i - phi_i'| / |phi_i|
+static void reportExcitationError(const vector<double>& errorSq, const vector<double>& normSq) {
+    double maxError = 0.0, sumErrorSq = 0.0, sumNormSq = 0.0;
+    for (int i = 0; i < errorSq.size(); i++) {
+        if (normSq[i] > 0.0) {
+            maxError = max(maxError, sqrt(errorSq[i] / normSq[i]));
+        }
+        sumErrorSq += errorSq[i];
+        sumNormSq += normSq[i];
+    }
+    cout << "Modal excitation error: " << (100.0 * sqrt(sumErrorSq / max(sumNormSq, 1e-30))) << "% rms, "
+         << (100.0 * maxError) << "% in the worst mode" << endl;
+}
+
+// picks the file to load the modes from (the binary version of a text modes file if it's up to
+// date) and reads everything but the mode shapes, which loadModeShapes reads later
+bool ModalAsset::readModesHeader(const string& fileName) {
+    modesSourceFileName = fileName;
+    modesTextFileName = "";
+    if (!isBinaryModesFile(fileName)) {
+        string binaryFileName = binaryModesFileName(fileName);
+        long long binaryTime = fileModifiedTime(binaryFileName);
+        if (binaryTime != 0 && binaryTime >= fileModifiedTime(fileName) && isBinaryModesFile(binaryFileName)) {
+            modesSourceFileName = binaryFileName;
+        } else {
+            if (binaryTime != 0) {
+                cout << binaryFileName << " is out of date or not a version " << MODES_FILE_VERSION
+                     << " modes file; it will be rebuilt" << endl;
+            }
+            modesTextFileName = fileName;     // converted once it's loaded
+        }
+    }
+
+    cout << "Reading modes data from " << modesSourceFileName << endl;
+    vector<float> fileEigenValues;
+    int numModes;
+    modesSourceIsBinary = modesTextFileName.empty();
+    if (modesSourceIsBinary) {
+        BinaryModesFile binaryFile;
+        if (!binaryFile.open(modesSourceFileName)) {
+            cout << "Failed to open " << modesSourceFileName << endl;
+            return false;
+        }
+        numModes = binaryFile.numModes();
+        numVertices = binaryFile.numVertices();
+        fileEigenValues.assign(binaryFile.eigenValues(), binaryFile.eigenValues() + numModes);
+    } else {
+        ifstream file;
+        file.open(modesSourceFileName, ios::in);
+        if (!file.is_open()) {
+            cout << "Failed to open " << modesSourceFileName << endl;
+            return false;
+        }
+        file >> numModes;
+        file >> numVertices;
+        if (!file || numModes <= 0 || numVertices <= 0) {
+            cout << "Bad header in " << modesSourceFileName << endl;
+            return false;
+        }
+        fileEigenValues.resize(numModes);
+        for (int i = 0; i < numModes; i++) {
+            file >> fileEigenValues[i];
+        }
+    }
+
+    // sort the modes by eigenvalue
+    modeOrder.resize(numModes);
+    for (int i = 0; i < numModes; i++) {
+        modeOrder[i] = i;
+    }
+    stable_sort(modeOrder.begin(), modeOrder.end(), EigenValueLess(fileEigenValues));
+    eigenValues.resize(numModes);
+    for (int k = 0; k < numModes; k++) {
+        eigenValues[k] = fileEigenValues[modeOrder[k]];
+    }
+    cout << numModes << " modes, " << numVertices << " vertices" << endl;
+    return true;
+}
+
+// stores the shape of the k-th lowest mode; component c of vertex j is src[j * stride + c]
+void ModalAsset::storeMode(int k, const float* src, int stride) {
+    if (storage == MODE_SHAPES_FLOAT || storage == MODE_SHAPES_LOW_RANK) {
+        for (int j = 0; j < numVertices; j++) {
+            for (int c = 0; c < 3; c++) {
+                phi(j, 3 * k + c) = src[j * stride + c];
+            }
+        }
+        return;
+    }
+
+    // 16 bits per component with a scale per mode. int16 uses the whole range; half floats
+    // are kept near 1 where they're most precise and can't overflow
+    float maxAbs = 0.f;
+    for (int j = 0; j < numVertices; j++) {
+        for (int c = 0; c < 3; c++) {
+            maxAbs = max(maxAbs, fabsf(src[j * stride + c]));
+        }
+    }
+    if (maxAbs == 0.f) {
+        return;
+    }
+    float scale = (storage == MODE_SHAPES_INT16) ? maxAbs / 32767.f : maxAbs;
+    modeScale[k] = scale;
+
+    // blocks of MODAL_BANK_WIDTH modes are laid out x[] y[] z[]
+    int block = k - k % MODAL_BANK_WIDTH;
+    int lane = k % MODAL_BANK_WIDTH;
+    int numModesPadded = modalBankPadded(numModes());
+    for (int j = 0; j < numVertices; j++) {
+        unsigned short* row = &phiQuantized[(size_t)j * 3 * numModesPadded];
+        for (int c = 0; c < 3; c++) {
+            float original = src[j * stride + c];
+            float value = original / scale;
+            unsigned short stored;
+            float dequantized;
+            if (storage == MODE_SHAPES_INT16) {
+                short s = (short)floorf(value + 0.5f);
+                stored = (unsigned short)s;
+                dequantized = s * scale;
+            } else {
+                stored = floatToHalf(value);
+                dequantized = halfToFloat(stored) * scale;
+            }
+            row[3 * block + c * MODAL_BANK_WIDTH + lane] = stored;
+            double error = dequantized - original;
+            quantizationErrorSq[k] += error * error;
+            quantizationNormSq[k] += (double)original * original;
+        }
+    }
+}
+
+// makes the lowest numLoaded modes available to the bodies. only whole blocks of
+// MODAL_BANK_WIDTH modes (or all of them) are published, so no block a body reads is still
+// being written.
+void ModalAsset::publishModes(int numLoaded) {
+    assert(numLoaded % MODAL_BANK_WIDTH == 0 || numLoaded == numModes());
+    if (numLoaded > modesLoaded.load(memory_order_relaxed)) {
+        modesLoaded.store(numLoaded, memory_order_release);
+    }
+}
+
+// reads the mode shapes, lowest frequency first, publishing them as it goes. runs on the loader
+// thread, except for low-rank storage which needs all of phi at once.
+void ModalAsset::loadModeShapes() {
+    unsigned long long startMicros = ofGetElapsedTimeMicros();
+    int numModes = this->numModes();
+    if (modesSourceIsBinary) {
+        BinaryModesFile file;
+        if (!file.open(modesSourceFileName)) {
+            cout << "Failed to open " << modesSourceFileName << endl;
+            return;
+        }
+        // copy the modes in chunks that double in size, so the first ones are out quickly and
+        // the (vertex-major) file is still only swept a few times
+        vector<float> chunk;
+        int chunkSize = MODAL_BANK_WIDTH;
+        for (int k0 = 0; k0 < numModes && !cancelLoading; k0 += chunkSize, chunkSize *= 2) {
+            int k1 = min(numModes, k0 + chunkSize);
+            int n = k1 - k0;
+            chunk.resize((size_t)numVertices * 3 * n);
+            for (int j = 0; j < numVertices; j++) {
+                const float* src = file.phiRow(j);
+                float* dst = &chunk[(size_t)j * 3 * n];
+                for (int k = k0; k < k1; k++) {
+                    int i = modeOrder[k];
+                    *dst++ = src[3 * i];
+                    *dst++ = src[3 * i + 1];
+                    *dst++ = src[3 * i + 2];
+                }
+            }
+            for (int k = k0; k < k1; k++) {
+                storeMode(k, &chunk[3 * (k - k0)], 3 * n);
+            }
+            publishModes(k1);
+        }
+    } else {
+        // the text file is mode-major: publish each mode as soon as all lower modes are in
+        ifstream file;
+        file.open(modesSourceFileName, ios::in);
+        if (!file.is_open()) {
+            cout << "Failed to open " << modesSourceFileName << endl;
+            return;
+        }
+        int unused;
+        float unusedEigenValue;
+        file >> unused >> unused;
+        for (int i = 0; i < numModes; i++) {
+            file >> unusedEigenValue;
+        }
+        vector<int> modeRank(numModes);
+        for (int k = 0; k < numModes; k++) {
+            modeRank[modeOrder[k]] = k;
+        }
+        vector<bool> modeIsLoaded(numModes, false);
+        int numLoaded = 0;
+        vector<float> mode(3 * numVertices);
+        for (int i = 0; i < numModes && !cancelLoading; i++) {
+            for (int j = 0; j < numVertices; j++) {
+                file >> mode[3 * j] >> mode[3 * j + 1] >> mode[3 * j + 2];
+            }
+            if (!file) {
+                cout << "Unexpected end of " << modesSourceFileName << endl;
+                return;
+            }
+            storeMode(modeRank[i], &mode[0], 3);
+            modeIsLoaded[modeRank[i]] = true;
+            while (numLoaded < numModes && modeIsLoaded[numLoaded]) {
+                numLoaded++;
+            }
+            if (numLoaded % MODAL_BANK_WIDTH == 0 || numLoaded == numModes) {
+                publishModes(numLoaded);
+            }
+        }
+    }
+    if (cancelLoading) {
+        return;
+    }
+    cout << "Loaded all " << numModes << " modes of " << modesSourceFileName << " in "
+         << ((ofGetElapsedTimeMicros() - startMicros) / 1000) << " ms" << endl;
+
+    if (storage == MODE_SHAPES_HALF || storage == MODE_SHAPES_INT16) {
+        float floatBytes = (float)numVertices * 3 * (modalBankPadded(numModes) + MODAL_BANK_WIDTH) * sizeof(float);
+        float quantizedBytes = (float)phiQuantized.size() * sizeof(unsigned short);
+        cout << "Mode shapes stored as " << (storage == MODE_SHAPES_INT16 ? "int16" : "half floats") << ": "
+             << (quantizedBytes / (1024.f * 1024.f)) << " MB instead of " << (floatBytes / (1024.f * 1024.f)) << " MB" << endl;
+        reportExcitationError(quantizationErrorSq, quantizationNormSq);
+    }
+
+    // so the next start can map the modes instead of parsing them
+    if (!modesTextFileName.empty()) {
+        convertModesFile(modesTextFileName, binaryModesFileName(modesTextFileName));
+    }
+}
+
+ModalAsset::ModalAsset(const string& objFileName, const string& modesFileName, const ModeShapeOptions& options)
+    :
+    volume(0.f),
+    radius(0.f),
+    storage(options.storage),
+    numVertices(0),
+    modesSourceIsBinary(false),
+    modesLoaded(0),
+    cancelLoading(false)
+{
+    readObj(objFileName, &mesh);
+
+    computeMassProperties();
+    vertexTree.build(mesh.getVerticesPointer(), mesh.getNumVertices());
+    hull.build(mesh.getVerticesPointer(), mesh.getNumVertices());
+
+    // a saved factorization of the modes saves reading phi at all
+    if (storage == MODE_SHAPES_LOW_RANK && readLowRankModes(modesFileName, options)) {
+        publishModes(numModes());
+        return;
+    }
+
+    if (!readModesHeader(modesFileName)) {
+        return;
+    }
+    assert(numVertices == mesh.getNumVertices());
+    int numModesPadded = modalBankPadded(numModes());
+    if (storage == MODE_SHAPES_FLOAT || storage == MODE_SHAPES_LOW_RANK) {
+        phi = ModeShapeMatrix::Zero(numVertices, 3 * (numModesPadded + MODAL_BANK_WIDTH));
+    } else {
+        modeScale.assign(numModesPadded + MODAL_BANK_WIDTH, 0.f);
+        phiQuantized.assign((size_t)numVertices * 3 * numModesPadded, 0);
+        quantizationErrorSq.assign(numModes(), 0.0);
+        quantizationNormSq.assign(numModes(), 0.0);
+    }
+
+    if (storage == MODE_SHAPES_LOW_RANK) {
+        loadModeShapes();
+        factorModeShapes(options);
+        writeLowRankModes(modesFileName, options);
+    } else {
+        loader = thread(&ModalAsset::loadModeShapes, this);
+    }
+}
+
+ModalAsset::~ModalAsset() {
+    cancelLoading = true;
+    if (loader.joinable()) {
+        loader.join();
+    }
+}
+
+// factors phi with a randomized SVD, then frees it
+void ModalAsset::factorModeShapes(const ModeShapeOptions& options) {
+    int numModes = this->numModes();
+    Eigen::MatrixXf A(3 * numVertices, numModes);
+    for (int j = 0; j < numVertices; j++) {
+        for (int i = 0; i < numModes; i++) {
+            for (int c = 0; c < 3; c++) {
+                A(3 * j + c, i) = phi(j, 3 * i + c);
+            }
+        }
+    }
+
+    // a few extra dimensions make the leading singular vectors of the randomized SVD accurate;
+    // to meet a tolerance, factor at full rank and truncate
+    int svdRank = (options.rank > 0) ? min(numModes, options.rank + 10) : numModes;
+    REDSVD::RedSVD svd;
+    svd.run(A, svdRank);
+    const Eigen::VectorXf& S = svd.singularValues();
+    int rank = S.size();
+    if (options.rank > 0) {
+        rank = min(rank, options.rank);
+    } else {
+        double tailSq = 0.0;
+        double maxTailSq = (double)options.tolerance * options.tolerance * S.squaredNorm();
+        while (rank > 1 && tailSq + (double)S[rank - 1] * S[rank - 1] <= maxTailSq) {
+            tailSq += (double)S[rank - 1] * S[rank - 1];
+            rank--;
+        }
+    }
+
+    phiU = svd.matrixU().leftCols(rank);
+    phiVS = ModeShapeMatrix::Zero(modalBankPadded(numModes) + MODAL_BANK_WIDTH, rank);
+    phiVS.topRows(numModes) = svd.matrixV().leftCols(rank) * S.head(rank).asDiagonal();
+
+    vector<double> errorSq(numModes), normSq(numModes);
+    Eigen::MatrixXf E = A - phiU * phiVS.topRows(numModes).transpose();
+    for (int i = 0; i < numModes; i++) {
+        errorSq[i] = E.col(i).squaredNorm();
+        normSq[i] = A.col(i).squaredNorm();
+    }
+    float floatBytes = (float)numVertices * 3 * (modalBankPadded(numModes) + MODAL_BANK_WIDTH) * sizeof(float);
+    float factorBytes = (float)(phiU.size() + phiVS.size()) * sizeof(float);
+    cout << "Mode shapes factored to rank " << rank << " of " << numModes << ": "
+         << (factorBytes / (1024.f * 1024.f)) << " MB instead of " << (floatBytes / (1024.f * 1024.f)) << " MB" << endl;
+    reportExcitationError(errorSq, normSq);
+
+    phi = ModeShapeMatrix();
+}
+
+// uses the factorization saved next to the modes file if it's newer than the modes file and
+// was made with the same options
+bool ModalAsset::readLowRankModes(const string& fileName, const ModeShapeOptions& options) {
+    string lowRankFileName = lowRankModesFileName(fileName);
+    if (fileModifiedTime(lowRankFileName) < fileModifiedTime(fileName)) {
+        return false;
+    }
+    LowRankModesFile file;
+    if (!file.open(lowRankFileName)) {
+        return false;
+    }
+    const LowRankModesFileHeader& header = file.header();
+    if (header.requestedRank != options.rank || header.requestedTolerance != options.tolerance ||
+        header.numVertices != mesh.getNumVertices()) {
+        return false;
+    }
+    cout << "Reading low-rank modes data from " << lowRankFileName << endl;
+    int numModes = header.numModes;
+    int rank = header.rank;
+    eigenValues.assign(file.eigenValues(), file.eigenValues() + numModes);
+    phiU = Eigen::Map<const ModeShapeMatrix>(file.U(), 3 * header.numVertices, rank);
+    phiVS = ModeShapeMatrix::Zero(modalBankPadded(numModes) + MODAL_BANK_WIDTH, rank);
+    phiVS.topRows(numModes) = Eigen::Map<const ModeShapeMatrix>(file.VS(), numModes, rank);
+    cout << numModes << " modes at rank " << rank << ", " << header.numVertices << " vertices" << endl;
+    return true;
+}
+
+void ModalAsset::writeLowRankModes(const string& fileName, const ModeShapeOptions& options) const {
+    LowRankModesFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LOW_RANK_MODES_FILE_MAGIC, 8);
+    header.version = LOW_RANK_MODES_FILE_VERSION;
+    header.numModes = numModes();
+    header.numVertices = phiU.rows() / 3;
+    header.rank = phiU.cols();
+    header.requestedRank = options.rank;
+    header.requestedTolerance = options.tolerance;
+    if (header.numModes == 0 || header.numVertices == 0) {
+        return;
+    }
+    string lowRankFileName = lowRankModesFileName(fileName);
+    if (writeLowRankModesFile(lowRankFileName, header, &eigenValues[0], phiU.data(), phiVS.data())) {
+        cout << "Saved low-rank modes to " << lowRankFileName << endl;
+    }
+}
+
+void ModalAsset::computeMassProperties() {
+    // all the moments in one pass over the triangles; big meshes are split into chunks that are
+    // integrated in parallel and then summed in order, so the result doesn't depend on timing
+    const int chunkTriangles = 16384;
+    int numTriangles = mesh.getNumIndices() / 3;
+    const ofVec3f* vertices = mesh.getVerticesPointer();
+    const ofIndexType* indices = mesh.getIndexPointer();
+    VolumeIntegrals integrals;
+    if (numTriangles < 4 * chunkTriangles) {
+        integrals.addTriangles(vertices, indices, 0, numTriangles);
+    } else {
+        int numChunks = (numTriangles + chunkTriangles - 1) / chunkTriangles;
+        vector<VolumeIntegrals> chunks(numChunks);
+        WorkerPool pool;
+        pool.parallelFor(numChunks, [&](int c) {
+            chunks[c].addTriangles(vertices, indices, c * chunkTriangles,
+                                   min((c + 1) * chunkTriangles, numTriangles));
+        });
+        for (int c = 0; c < numChunks; c++) {
+            integrals.add(chunks[c]);
+        }
+    }
+    const double* intg = integrals.intg;
+    double M = intg[VolumeIntegrals::ONE];
+    volume = (float)M;
+    double cx = intg[VolumeIntegrals::X] / M;
+    double cy = intg[VolumeIntegrals::Y] / M;
+    double cz = intg[VolumeIntegrals::Z] / M;
+
+    // second moments about the center of mass (parallel axis theorem), made positive if the
+    // triangles wind inwards
+    Eigen::Matrix3d C;
+    C(0, 0) = intg[VolumeIntegrals::XX] - M * cx * cx;
+    C(1, 1) = intg[VolumeIntegrals::YY] - M * cy * cy;
+    C(2, 2) = intg[VolumeIntegrals::ZZ] - M * cz * cz;
+    C(0, 1) = C(1, 0) = intg[VolumeIntegrals::XY] - M * cx * cy;
+    C(1, 2) = C(2, 1) = intg[VolumeIntegrals::YZ] - M * cy * cz;
+    C(0, 2) = C(2, 0) = intg[VolumeIntegrals::ZX] - M * cz * cx;
+    if (M < 0.0) {
+        C = -C;
+    }
+
+    // the inertia tensor rho * (trace(C) * I - C) has the same eigenvectors as C
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eigenSolver(C);
+    Eigen::Vector3d moments = eigenSolver.eigenvalues();
+    Eigen::Matrix3d axes = eigenSolver.eigenvectors();
+    if (axes.determinant() < 0.0) {
+        axes.col(2) = -axes.col(2);     // keep it a rotation
+    }
+    principalMoments = ofVec3f((float)moments(0), (float)moments(1), (float)moments(2));
+    principalAxes = ofMatrix3x3((float)axes(0, 0), (float)axes(0, 1), (float)axes(0, 2),
+                                (float)axes(1, 0), (float)axes(1, 1), (float)axes(1, 2),
+                                (float)axes(2, 0), (float)axes(2, 1), (float)axes(2, 2));
+
+    // move mesh so its center of mass is at origin
+    ofVec3f centerOfMass((float)cx, (float)cy, (float)cz);
+    ofVec3f* meshVertices = mesh.getVerticesPointer();
+    float radiusSq = 0.f;
+    for (int i = 0; i < mesh.getNumVertices(); i++) {
+        meshVertices[i] -= centerOfMass;
+        radiusSq = max(radiusSq, meshVertices[i].lengthSquared());
+    }
+    radius = sqrtf(radiusSq);
+}
+
+// assets by "objFileName|modesFileName|storage[|rank|tolerance]". the cache doesn't keep an asset alive; it's freed
+// along with the last body that uses it.
+static map<string, weak_ptr<const ModalAsset> > assetCache;
+static mutex assetCacheMutex;
+
+shared_ptr<const ModalAsset> ModalAsset::load(const string& objFileName, const string& modesFileName,
+                                              const ModeShapeOptions& options) {
+    lock_guard<mutex> lock(assetCacheMutex);
+    string key = objFileName + "|" + modesFileName + "|" + ofToString((int)options.storage);
+    if (options.storage == MODE_SHAPES_LOW_RANK) {
+        key += "|" + ofToString(options.rank) + "|" + ofToString(options.tolerance);
+    }
+    shared_ptr<const ModalAsset> asset = assetCache[key].lock();
+    if (asset) {
+        cout << "Sharing loaded " << objFileName << " and " << modesFileName << endl;
+    } else {
+        asset = make_shared<ModalAsset>(objFileName, modesFileName, options);
+        assetCache[key] = asset;
+    }
+    return asset;
+}
@@ -0,0 +1,111 @@
+#ifndef MODALASSET_H
+#define MODALASSET_H
+
+#include <Eigen/Dense>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include "ModalBank.h"
+#include "KdTree.h"
+#include "ConvexHull.h"
+
+#include "ofMain.h"
+
+// Mode shapes, vertex-major: row j holds [mode][xyz] of vertex j, i.e. phi(j, 3*i + c) is
+// component c of mode i at vertex j. The modes are padded with zeros (see ModalAsset::phi) so a
+// row projects straight onto the padded modal arrays.
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> ModeShapeMatrix;
+
+// How an asset stores its mode shapes. For MODE_SHAPES_LOW_RANK, phi is factored to the given
+// rank, or if rank is 0, to the lowest rank whose relative (Frobenius) error is within tolerance.
+struct ModeShapeOptions {
+    ModeShapeOptions(ModeShapeStorage storage = MODE_SHAPES_FLOAT, int rank = 0, float tolerance = 0.01f)
+        : storage(storage), rank(rank), tolerance(tolerance) {}
+    ModeShapeStorage storage;
+    int rank;
+    float tolerance;
+};
+
+// The geometry and modes read from an .obj file and a modes file, at unit size scale and in the
+// material of the modes file. Assets are shared by every RigidBody made from the same pair of
+// files, and apart from the mode shapes streaming in (see numModesLoaded) they never change;
+// each body applies its own size and material scale factors.
+struct ModalAsset {
+    ModalAsset(const string& objFileName, const string& modesFileName,
+               const ModeShapeOptions& options = ModeShapeOptions());
+
+    // returns the asset for the pair of files, loading it only if no body holds it already
+    static shared_ptr<const ModalAsset> load(const string& objFileName, const string& modesFileName,
+                                             const ModeShapeOptions& options = ModeShapeOptions());
+
+    ~ModalAsset();
+
+    int numModes() const { return eigenValues.size(); }
+
+    // The mode shapes are loaded on a thread, lowest frequency first: only the lowest
+    // numModesLoaded() modes may be used. Everything else is there once the asset is made.
+    int numModesLoaded() const { return modesLoaded.load(memory_order_acquire); }
+
+    // 16-bit mode shapes of vertex j, in the layout projectQuantizedModes takes
+    const unsigned short* quantizedRow(int j) const {
+        return &phiQuantized[(size_t)j * 3 * modalBankPadded(numModes())];
+    }
+
+    // Geometry (center of mass at the origin)
+    ofMesh mesh;
+    float volume;           // signed
+    float radius;           // max distance of a vertex from the center of mass
+
+    // Principal axes of the volume: the columns of principalAxes (a rotation) are the directions
+    // along which the second moments about the center of mass are principalMoments, ascending.
+    // With uniform density the inertia tensor is diagonal in this frame.
+    ofVec3f principalMoments;
+    ofMatrix3x3 principalAxes;
+
+    KdTree vertexTree;      // the mesh vertices, for nearest-vertex queries
+    ConvexHull hull;        // of the mesh vertices, for support queries
+
+    // Modes, sorted by ascending eigenvalue so any band of frequencies is a contiguous range.
+    // phi has 3 * (modalBankPadded(numModes) + MODAL_BANK_WIDTH) columns: a body can read a
+    // padded block of modes starting at any mode without running off the end of a row.
+    vector<float> eigenValues;
+    ModeShapeStorage storage;
+    ModeShapeMatrix phi;                    // MODE_SHAPES_FLOAT only
+
+    // 16-bit storages: phi(j, 3*i + c) = modeScale[i] * (component c of mode i in quantizedRow(j)).
+    // modeScale is padded like the rows of phi, with 0s past the last mode.
+    vector<unsigned short> phiQuantized;
+    AlignedFloats modeScale;
+
+    // low rank: phi ~= phiU * phiVS^T, one row of phiU per vertex component (3*j + c) and one
+    // row of phiVS per mode. phiVS is padded like the rows of phi, with 0s past the last mode.
+    ModeShapeMatrix phiU;
+    ModeShapeMatrix phiVS;
+
+private:
+    void computeMassProperties();
+    bool readModesHeader(const string& fileName);
+    void loadModeShapes();
+    void storeMode(int k, const float* src, int stride);
+    void publishModes(int numLoaded);
+    void factorModeShapes(const ModeShapeOptions& options);
+    bool readLowRankModes(const string& fileName, const ModeShapeOptions& options);
+    void writeLowRankModes(const string& fileName, const ModeShapeOptions& options) const;
+
+    // what the loader reads, set up by readModesHeader
+    int numVertices;
+    string modesSourceFileName;
+    bool modesSourceIsBinary;
+    string modesTextFileName;       // converted to binary once loaded, if not already
+    vector<int> modeOrder;          // file index of each mode, in ascending order
+    vector<double> quantizationErrorSq, quantizationNormSq;
+
+    atomic<int> modesLoaded;
+    atomic<bool> cancelLoading;
+    thread loader;
+
+    ModalAsset(const ModalAsset&);
+    ModalAsset& operator=(const ModalAsset&);
+};
+
+#endif
@@ -0,0 +1,374 @@
+#include "ModalBank.h"
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define MODAL_BANK_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MODAL_BANK_TARGET_AVX2
+#define MODAL_BANK_TARGET_F16C
+#else
+#include <cpuid.h>
+#define MODAL_BANK_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define MODAL_BANK_TARGET_F16C __attribute__((target("avx2,fma,f16c")))
+#endif
+#endif
+
+// samples are processed in blocks so the per-sample partial sums fit on the stack (and in L1)
+#define SAMPLE_BLOCK 64
+
+typedef void (*ResonatorBankBlockFn)(const float* a, const float* b, const float* u,
+                                     float* q1, float* q2, int begin, int end,
+                                     int numSamples, float* qSum);
+
+// Each kernel below iterates over the modes in the outer loop so the coefficients and the state
+// of a group of modes stay in registers for the whole block of samples. The per-sample sums of
+// each lane are collected in "partial" and reduced horizontally once per block.
+
+static void resonatorBlockScalar(const float* a, const float* b, const float* u,
+                                 float* q1, float* q2, int begin, int end,
+                                 int numSamples, float* qSum) {
+    for (int i = begin; i < end; i++) {
+        float ai = a[i];
+        float bi = b[i];
+        float qk1 = q1[i];
+        float qk2 = q2[i];
+        for (int k = 0; k < numSamples; k++) {
+            float qk = ai*qk1 - bi*qk2;
+            if (k == 0 && u) {
+                qk += u[i];
+            }
+            qSum[k] += qk;
+            qk2 = qk1;
+            qk1 = qk;
+        }
+        q1[i] = qk1;
+        q2[i] = qk2;
+    }
+}
+
+typedef void (*ProjectModesFn)(const unsigned short* row, const float* force,
+                               int begin, int end, float* out);
+
+// Projection kernels for 16-bit mode shapes. Each block of MODAL_BANK_WIDTH modes is 3 planes
+// (x, y, z), so the 3 components of a mode land in the same lane and no shuffles are needed.
+
+static void projectModesInt16Scalar(const unsigned short* row, const float* force,
+                                    int begin, int end, float* out) {
+    for (int i = begin; i < end; i += MODAL_BANK_WIDTH) {
+        const short* block = (const short*)row + 3 * i;
+        for (int l = 0; l < MODAL_BANK_WIDTH; l++) {
+            out[i + l] += block[l] * force[0]
+                        + block[MODAL_BANK_WIDTH + l] * force[1]
+                        + block[2 * MODAL_BANK_WIDTH + l] * force[2];
+        }
+    }
+}
+
+static void projectModesHalfScalar(const unsigned short* row, const float* force,
+                                   int begin, int end, float* out) {
+    for (int i = begin; i < end; i += MODAL_BANK_WIDTH) {
+        const unsigned short* block = row + 3 * i;
+        for (int l = 0; l < MODAL_BANK_WIDTH; l++) {
+            out[i + l] += halfToFloat(block[l]) * force[0]
+                        + halfToFloat(block[MODAL_BANK_WIDTH + l]) * force[1]
+                        + halfToFloat(block[2 * MODAL_BANK_WIDTH + l]) * force[2];
+        }
+    }
+}
+
+#ifdef MODAL_BANK_X86
+
+static void resonatorBlockSSE(const float* a, const float* b, const float* u,
+                              float* q1, float* q2, int begin, int end,
+                              int numSamples, float* qSum) {
+    __m128 partial[SAMPLE_BLOCK];
+    for (int k = 0; k < numSamples; k++) {
+        partial[k] = _mm_setzero_ps();
+    }
+    for (int i = begin; i < end; i += 4) {
+        __m128 ai = _mm_load_ps(&a[i]);
+        __m128 bi = _mm_load_ps(&b[i]);
+        __m128 qk1 = _mm_load_ps(&q1[i]);
+        __m128 qk2 = _mm_load_ps(&q2[i]);
+        int k = 0;
+        if (u) {
+            __m128 qk = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(ai, qk1), _mm_mul_ps(bi, qk2)),
+                                   _mm_load_ps(&u[i]));
+            partial[0] = _mm_add_ps(partial[0], qk);
+            qk2 = qk1;
+            qk1 = qk;
+            k = 1;
+        }
+        for (; k < numSamples; k++) {
+            __m128 qk = _mm_sub_ps(_mm_mul_ps(ai, qk1), _mm_mul_ps(bi, qk2));
+            partial[k] = _mm_add_ps(partial[k], qk);
+            qk2 = qk1;
+            qk1 = qk;
+        }
+        _mm_store_ps(&q1[i], qk1);
+        _mm_store_ps(&q2[i], qk2);
+    }
+    for (int k = 0; k < numSamples; k++) {
+        __m128 s = _mm_add_ps(partial[k], _mm_movehl_ps(partial[k], partial[k]));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        qSum[k] += _mm_cvtss_f32(s);
+    }
+}
+
+MODAL_BANK_TARGET_AVX2
+static void resonatorBlockAVX2(const float* a, const float* b, const float* u,
+                               float* q1, float* q2, int begin, int end,
+                               int numSamples, float* qSum) {
+    __m256 partial[SAMPLE_BLOCK];
+    for (int k = 0; k < numSamples; k++) {
+        partial[k] = _mm256_setzero_ps();
+    }
+    // mode arrays are only guaranteed 16-byte aligned, so use unaligned loads
+    for (int i = begin; i < end; i += 8) {
+        __m256 ai = _mm256_loadu_ps(&a[i]);
+        __m256 bi = _mm256_loadu_ps(&b[i]);
+        __m256 qk1 = _mm256_loadu_ps(&q1[i]);
+        __m256 qk2 = _mm256_loadu_ps(&q2[i]);
+        int k = 0;
+        if (u) {
+            __m256 qk = _mm256_fmsub_ps(ai, qk1, _mm256_fmsub_ps(bi, qk2, _mm256_loadu_ps(&u[i])));
+            partial[0] = _mm256_add_ps(partial[0], qk);
+            qk2 = qk1;
+            qk1 = qk;
+            k = 1;
+        }
+        for (; k < numSamples; k++) {
+            __m256 qk = _mm256_fmsub_ps(ai, qk1, _mm256_mul_ps(bi, qk2));
+            partial[k] = _mm256_add_ps(partial[k], qk);
+            qk2 = qk1;
+            qk1 = qk;
+        }
+        _mm256_storeu_ps(&q1[i], qk1);
+        _mm256_storeu_ps(&q2[i], qk2);
+    }
+    for (int k = 0; k < numSamples; k++) {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(partial[k]), _mm256_extractf128_ps(partial[k], 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        qSum[k] += _mm_cvtss_f32(s);
+    }
+}
+
+// 4 int16's to floats
+static inline __m128 int16ToFloatSSE(__m128i v, bool high) {
+    __m128i v32 = high ? _mm_unpackhi_epi16(v, v) : _mm_unpacklo_epi16(v, v);
+    return _mm_cvtepi32_ps(_mm_srai_epi32(v32, 16));
+}
+
+static void projectModesInt16SSE(const unsigned short* row, const float* force,
+                                 int begin, int end, float* out) {
+    __m128 fx = _mm_set1_ps(force[0]);
+    __m128 fy = _mm_set1_ps(force[1]);
+    __m128 fz = _mm_set1_ps(force[2]);
+    for (int i = begin; i < end; i += 8) {
+        const __m128i* block = (const __m128i*)(row + 3 * i);
+        __m128i x = _mm_loadu_si128(block);
+        __m128i y = _mm_loadu_si128(block + 1);
+        __m128i z = _mm_loadu_si128(block + 2);
+        for (int half = 0; half < 2; half++) {
+            __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(int16ToFloatSSE(x, half != 0), fx),
+                                               _mm_mul_ps(int16ToFloatSSE(y, half != 0), fy)),
+                                    _mm_mul_ps(int16ToFloatSSE(z, half != 0), fz));
+            float* o = &out[i + 4 * half];
+            _mm_store_ps(o, _mm_add_ps(_mm_load_ps(o), sum));
+        }
+    }
+}
+
+MODAL_BANK_TARGET_AVX2
+static void projectModesInt16AVX2(const unsigned short* row, const float* force,
+                                  int begin, int end, float* out) {
+    __m256 fx = _mm256_set1_ps(force[0]);
+    __m256 fy = _mm256_set1_ps(force[1]);
+    __m256 fz = _mm256_set1_ps(force[2]);
+    for (int i = begin; i < end; i += 8) {
+        const __m128i* block = (const __m128i*)(row + 3 * i);
+        __m256 x = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(block)));
+        __m256 y = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(block + 1)));
+        __m256 z = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(block + 2)));
+        __m256 sum = _mm256_fmadd_ps(x, fx, _mm256_fmadd_ps(y, fy, _mm256_fmadd_ps(z, fz, _mm256_loadu_ps(&out[i]))));
+        _mm256_storeu_ps(&out[i], sum);
+    }
+}
+
+MODAL_BANK_TARGET_F16C
+static void projectModesHalfAVX2(const unsigned short* row, const float* force,
+                                 int begin, int end, float* out) {
+    __m256 fx = _mm256_set1_ps(force[0]);
+    __m256 fy = _mm256_set1_ps(force[1]);
+    __m256 fz = _mm256_set1_ps(force[2]);
+    for (int i = begin; i < end; i += 8) {
+        const __m128i* block = (const __m128i*)(row + 3 * i);
+        __m256 x = _mm256_cvtph_ps(_mm_loadu_si128(block));
+        __m256 y = _mm256_cvtph_ps(_mm_loadu_si128(block + 1));
+        __m256 z = _mm256_cvtph_ps(_mm_loadu_si128(block + 2));
+        __m256 sum = _mm256_fmadd_ps(x, fx, _mm256_fmadd_ps(y, fy, _mm256_fmadd_ps(z, fz, _mm256_loadu_ps(&out[i]))));
+        _mm256_storeu_ps(&out[i], sum);
+    }
+}
+
+static void cpuid(int leaf, int* info) {
+#ifdef _MSC_VER
+    __cpuidex(info, leaf, 0);
+#else
+    unsigned int eax, ebx, ecx, edx;
+    __cpuid_count(leaf, 0, eax, ebx, ecx, edx);
+    info[0] = eax, info[1] = ebx, info[2] = ecx, info[3] = edx;
+#endif
+}
+
+static bool cpuHasSSE() {
+    int info[4];
+    cpuid(1, info);
+    return (info[3] & (1 << 25)) != 0;
+}
+
+static bool cpuHasAVX2() {
+    int info[4];
+    cpuid(0, info);
+    if (info[0] < 7) return false;
+    cpuid(1, info);
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!(fma && osxsave && avx)) return false;
+
+    // the OS must save the ymm registers on context switches
+#ifdef _MSC_VER
+    unsigned long long xcr0 = _xgetbv(0);
+#else
+    unsigned int xlo, xhi;
+    __asm__ ("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+    unsigned long long xcr0 = ((unsigned long long)xhi << 32) | xlo;
+#endif
+    if ((xcr0 & 6) != 6) return false;
+
+    cpuid(7, info);
+    return (info[1] & (1 << 5)) != 0;
+}
+
+// half float conversions; only checked once AVX2 is known to be usable
+static bool cpuHasF16C() {
+    int info[4];
+    cpuid(1, info);
+    return (info[2] & (1 << 29)) != 0;
+}
+
+#endif
+
+struct ResonatorBankKernel {
+    ResonatorBankKernel() {
+        block = resonatorBlockScalar;
+        projectInt16 = projectModesInt16Scalar;
+        projectHalf = projectModesHalfScalar;
+        name = "scalar";
+#ifdef MODAL_BANK_X86
+        if (cpuHasAVX2()) {
+            block = resonatorBlockAVX2;
+            projectInt16 = projectModesInt16AVX2;
+            if (cpuHasF16C()) {
+                projectHalf = projectModesHalfAVX2;
+            }
+            name = "avx2";
+        } else if (cpuHasSSE()) {
+            block = resonatorBlockSSE;
+            projectInt16 = projectModesInt16SSE;
+            name = "sse";
+        }
+#endif
+    }
+    ResonatorBankBlockFn block;
+    ProjectModesFn projectInt16;
+    ProjectModesFn projectHalf;
+    const char* name;
+};
+
+// picked once at startup
+static const ResonatorBankKernel kernel;
+
+void runResonatorBank(const float* a, const float* b, const float* u, float* q1, float* q2,
+                      int begin, int end, int numSamples, float* qSum) {
+    assert(begin % MODAL_BANK_WIDTH == 0);
+    end = modalBankPadded(end);
+    if (begin >= end) {
+        return;
+    }
+    for (int k0 = 0; k0 < numSamples; k0 += SAMPLE_BLOCK) {
+        int n = numSamples - k0 < SAMPLE_BLOCK ? numSamples - k0 : SAMPLE_BLOCK;
+        kernel.block(a, b, k0 == 0 ? u : NULL, q1, q2, begin, end, n, &qSum[k0]);
+    }
+}
+
+const char* resonatorBankKernelName() {
+    return kernel.name;
+}
+
+void projectQuantizedModes(ModeShapeStorage storage, const unsigned short* row,
+                           const float* force, int begin, int end, float* out) {
+    assert(begin % MODAL_BANK_WIDTH == 0);
+    assert(storage != MODE_SHAPES_FLOAT);
+    end = modalBankPadded(end);
+    if (storage == MODE_SHAPES_INT16) {
+        kernel.projectInt16(row, force, begin, end, out);
+    } else {
+        kernel.projectHalf(row, force, begin, end, out);
+    }
+}
+
+unsigned short floatToHalf(float f) {
+    unsigned int x;
+    memcpy(&x, &f, sizeof(x));
+    unsigned short sign = (x >> 16) & 0x8000;
+    int exponent = (int)((x >> 23) & 0xff) - 127 + 15;
+    unsigned int mantissa = x & 0x7fffff;
+    if (exponent >= 31) {
+        // overflow, inf or nan
+        bool nan = (x & 0x7fffffff) > 0x7f800000;
+        return sign | (nan ? 0x7e00 : 0x7c00);
+    }
+    int shift = 13;
+    unsigned int h = (exponent << 10) | (mantissa >> 13);
+    if (exponent <= 0) {
+        // subnormal half: the implicit 1 becomes explicit
+        if (exponent < -10) {
+            return sign;
+        }
+        shift = 14 - exponent;
+        mantissa |= 0x800000;
+        h = mantissa >> shift;
+    }
+    // round to nearest even; a carry out of the mantissa correctly bumps the exponent
+    unsigned int rest = mantissa & ((1u << shift) - 1);
+    unsigned int halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (h & 1))) {
+        h++;
+    }
+    return sign | (unsigned short)h;
+}
+
+float halfToFloat(unsigned short h) {
+    unsigned int sign = (unsigned int)(h & 0x8000) << 16;
+    int exponent = (h >> 10) & 0x1f;
+    unsigned int mantissa = h & 0x3ff;
+    unsigned int x;
+    if (exponent == 0) {
+        float f = ldexpf((float)mantissa, -24);
+        return sign ? -f : f;
+    } else if (exponent == 31) {
+        x = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        x = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
@@ -0,0 +1,46 @@
+#ifndef MODALBANK_H
+#define MODALBANK_H
+
+#include <vector>
+#include <Eigen/Core>
+
+// Mode arrays are padded to a multiple of this many floats so the resonator bank kernels
+// can always process whole SIMD vectors.
+#define MODAL_BANK_WIDTH 8
+
+typedef std::vector<float, Eigen::aligned_allocator<float>> AlignedFloats;
+
+inline int modalBankPadded(int n) {
+    return (n + MODAL_BANK_WIDTH - 1) / MODAL_BANK_WIDTH * MODAL_BANK_WIDTH;
+}
+
+// Runs a bank of independent two-pole resonators
+//     q(k) = a * q(k-1) - b * q(k-2) + (k == 0 ? u : 0)
+// over the modes [begin, end) for numSamples samples, and adds the sum of q(k) over those modes
+// to qSum[k]. On entry q1 holds q(k-1) and q2 holds q(k-2); both are advanced in place so that on
+// return q1 holds the newest q. u may be NULL if there's no excitation.
+// begin must be a multiple of MODAL_BANK_WIDTH, and all arrays must be 16-byte aligned and
+// readable up to modalBankPadded(end).
+void runResonatorBank(const float* a, const float* b, const float* u, float* q1, float* q2,
+                      int begin, int end, int numSamples, float* qSum);
+
+// name of the kernel picked for this CPU ("avx2", "sse" or "scalar")
+const char* resonatorBankKernelName();
+
+// How mode shapes are stored. The 16-bit formats are relative to a per-mode scale; low rank
+// stores a truncated SVD of phi.
+enum ModeShapeStorage { MODE_SHAPES_FLOAT, MODE_SHAPES_HALF, MODE_SHAPES_INT16, MODE_SHAPES_LOW_RANK };
+
+// Adds the projection of a force onto one vertex's row of 16-bit mode shapes, without the
+// per-mode scales: out[i] += x[i]*force[0] + y[i]*force[1] + z[i]*force[2] for the modes
+// [begin, end). The row is stored in blocks of MODAL_BANK_WIDTH modes, each laid out as
+// x[MODAL_BANK_WIDTH] y[MODAL_BANK_WIDTH] z[MODAL_BANK_WIDTH].
+// begin must be a multiple of MODAL_BANK_WIDTH; end is rounded up to one.
+void projectQuantizedModes(ModeShapeStorage storage, const unsigned short* row,
+                           const float* force, int begin, int end, float* out);
+
+// IEEE 754 half floats, rounded to nearest even
+unsigned short floatToHalf(float f);
+float halfToFloat(unsigned short h);
+
+#endif
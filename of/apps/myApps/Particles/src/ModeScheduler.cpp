@@ -0,0 +1,69 @@
+#include "ModeScheduler.h"
+#include "RigidBody.h"
+#include "QualityGovernor.h"
+#include <algorithm>
+
+float audibilityWeight(float hz) {
+    // IEC 61672 A-weighting curve
+    const float f2 = hz*hz;
+    const float c1 = 20.6f*20.6f;
+    const float c2 = 107.7f*107.7f;
+    const float c3 = 737.9f*737.9f;
+    const float c4 = 12194.f*12194.f;
+    float ra = (c4*f2*f2) / ((f2 + c1) * sqrtf((f2 + c2)*(f2 + c3)) * (f2 + c4));
+    return ra * 1.2589f;    // +2 dB puts 1 kHz at 1
+}
+
+ModeScheduler::ModeScheduler()
+    :
+    enabled(true),
+    budget(256),
+    audibleModes(0),
+    voicedModes(0)
+{}
+
+void ModeScheduler::schedule(const vector<RigidBody*>& bodies, const QualityGovernor& governor) {
+    candidates.clear();
+    for (int b = 0; b < bodies.size(); b++) {
+        RigidBody& body = *bodies[b];
+        std::fill(body.modeSelected.begin(), body.modeSelected.end(), 0);
+        if (body.audioAsleep) {
+            continue;
+        }
+        int bodyBegin = candidates.size();
+        int numActive = 0;
+        for (int i = body.activeBegin; i < body.activeEnd; i++) {
+            if (body.modeAudibility[i] > 0.f) {
+                numActive++;
+                float loudnessSq = body.modeLoudnessSq(i);
+                if (loudnessSq > 0.f) {
+                    candidates.push_back(Candidate(body.modeAudibility[i] * sqrtf(loudnessSq), b, i));
+                }
+            }
+        }
+        // per-body cap from the quality governor: only the body's loudest modes compete
+        int cap = governor.modeCap(numActive);
+        if ((int)candidates.size() - bodyBegin > cap) {
+            std::nth_element(candidates.begin() + bodyBegin, candidates.begin() + bodyBegin + cap, candidates.end());
+            candidates.erase(candidates.begin() + bodyBegin + cap, candidates.end());
+        }
+    }
+    audibleModes = candidates.size();
+
+    // keep the loudest modes within budget
+    int toVoice = audibleModes;
+    if (enabled && budget < toVoice) {
+        toVoice = max(budget, 0);
+        std::nth_element(candidates.begin(), candidates.begin() + toVoice, candidates.end());
+    }
+    voicedModes = toVoice;
+
+    for (int c = 0; c < toVoice; c++) {
+        bodies[candidates[c].body]->modeSelected[candidates[c].mode] = 1;
+    }
+    for (RigidBody* body : bodies) {
+        if (!body->audioAsleep) {
+            body->applyModeSelection();
+        }
+    }
+}
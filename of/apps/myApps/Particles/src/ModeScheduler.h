@@ -0,0 +1,42 @@
+#ifndef MODESCHEDULER_H
+#define MODESCHEDULER_H
+
+#include <vector>
+
+struct RigidBody;
+class QualityGovernor;
+
+// relative loudness of a tone at the given frequency as perceived by the ear (A-weighting,
+// normalized to 1 at 1 kHz)
+float audibilityWeight(float hz);
+
+// Scene-wide mode budget. Every audio frame, ranks the modes of all awake bodies by their
+// envelope amplitude weighted by audibility, and voices only the loudest "budget" of them.
+// A QualityGovernor further caps how many modes each body may voice.
+// Modes that lose their voice are faded out by the bodies rather than cut.
+class ModeScheduler {
+public:
+    ModeScheduler();
+
+    // to be called between RigidBody::prepareAudio and RigidBody::synthesizeAudio
+    void schedule(const std::vector<RigidBody*>& bodies, const QualityGovernor& governor);
+
+    bool enabled;
+    int budget;         // max number of modes voiced per frame, summed over all bodies
+
+    // stats of the last frame
+    int audibleModes;   // modes that had anything to play
+    int voicedModes;    // modes that were voiced
+
+private:
+    struct Candidate {
+        Candidate(float score, int body, int mode) : score(score), body(body), mode(mode) {}
+        bool operator<(const Candidate& c) const { return score > c.score; }    // loudest first
+        float score;
+        int body;
+        int mode;
+    };
+    std::vector<Candidate> candidates;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "ModesFile.h"
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+using namespace std;
+
+// a header of the current version that fits a file of fileSize bytes
+static bool isValidModesHeader(const ModesFileHeader& h, size_t fileSize) {
+    return fileSize >= sizeof(ModesFileHeader) &&
+           memcmp(h.magic, MODES_FILE_MAGIC, 8) == 0 &&
+           h.version == MODES_FILE_VERSION &&
+           h.phiOffset % 64 == 0 &&
+           h.phiOffset >= sizeof(ModesFileHeader) + h.numModes * sizeof(float) &&
+           fileSize >= h.phiOffset + (size_t)h.numVertices * h.numModes * 3 * sizeof(float);
+}
+
+bool BinaryModesFile::open(const string& fileName) {
+    if (!file.open(fileName)) {
+        return false;
+    }
+    bool valid = file.size() >= sizeof(ModesFileHeader) && isValidModesHeader(*header(), file.size());
+    if (!valid) {
+        cout << fileName << " is not a valid version " << MODES_FILE_VERSION << " binary modes file" << endl;
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+bool LowRankModesFile::open(const string& fileName) {
+    if (!file.open(fileName)) {
+        return false;
+    }
+    const LowRankModesFileHeader& h = header();
+    bool valid = file.size() >= sizeof(LowRankModesFileHeader) &&
+                 memcmp(h.magic, LOW_RANK_MODES_FILE_MAGIC, 8) == 0 &&
+                 h.version == LOW_RANK_MODES_FILE_VERSION &&
+                 file.size() == sizeof(LowRankModesFileHeader) +
+                     ((size_t)h.numModes + ((size_t)3 * h.numVertices + h.numModes) * h.rank) * sizeof(float);
+    if (!valid) {
+        cout << fileName << " is not a valid version " << LOW_RANK_MODES_FILE_VERSION << " low-rank modes file" << endl;
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+bool writeLowRankModesFile(const string& fileName, const LowRankModesFileHeader& header,
+                           const float* eigenValues, const float* U, const float* VS) {
+    vector<pair<const void*, size_t> > blocks;
+    blocks.push_back(make_pair((const void*)&header, sizeof(header)));
+    blocks.push_back(make_pair((const void*)eigenValues, header.numModes * sizeof(float)));
+    blocks.push_back(make_pair((const void*)U, (size_t)3 * header.numVertices * header.rank * sizeof(float)));
+    blocks.push_back(make_pair((const void*)VS, (size_t)header.numModes * header.rank * sizeof(float)));
+    return writeFileAtomically(fileName, blocks);
+}
+
+bool isBinaryModesFile(const string& fileName) {
+    ifstream file(fileName.c_str(), ios::in | ios::binary);
+    ModesFileHeader header;
+    if (!file.read((char*)&header, sizeof(header))) {
+        return false;
+    }
+    file.seekg(0, ios::end);
+    return isValidModesHeader(header, (size_t)file.tellg());
+}
+
+string binaryModesFileName(const string& textFileName) {
+    return replaceFileExtension(textFileName, ".bin");
+}
+
+string lowRankModesFileName(const string& modesFileName) {
+    return replaceFileExtension(modesFileName, ".svd");
+}
+
+bool convertModesFile(const string& textFileName, const string& binaryFileName) {
+    cout << "Converting " << textFileName << " to " << binaryFileName << endl;
+    ifstream in(textFileName.c_str(), ios::in);
+    if (!in.is_open()) {
+        cout << "Failed to open " << textFileName << endl;
+        return false;
+    }
+    int numModes, numVertices;
+    in >> numModes >> numVertices;
+    if (!in || numModes <= 0 || numVertices <= 0) {
+        cout << "Bad header in " << textFileName << endl;
+        return false;
+    }
+    vector<float> eigenValues(numModes);
+    for (int i = 0; i < numModes; i++) {
+        in >> eigenValues[i];
+    }
+    // transpose to vertex-major as we go
+    vector<float> phi((size_t)numVertices * numModes * 3);
+    for (int i = 0; i < numModes; i++) {
+        for (int j = 0; j < numVertices; j++) {
+            float* phi_i_j = &phi[((size_t)j * numModes + i) * 3];
+            in >> phi_i_j[0] >> phi_i_j[1] >> phi_i_j[2];
+        }
+    }
+    if (!in) {
+        cout << "Unexpected end of " << textFileName << endl;
+        return false;
+    }
+
+    ModesFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MODES_FILE_MAGIC, 8);
+    header.version = MODES_FILE_VERSION;
+    header.numModes = numModes;
+    header.numVertices = numVertices;
+    header.phiOffset = (sizeof(ModesFileHeader) + numModes * sizeof(float) + 63) / 64 * 64;
+
+    vector<char> padding(header.phiOffset - sizeof(header) - numModes * sizeof(float), 0);
+    vector<pair<const void*, size_t> > blocks;
+    blocks.push_back(make_pair((const void*)&header, sizeof(header)));
+    blocks.push_back(make_pair((const void*)&eigenValues[0], numModes * sizeof(float)));
+    blocks.push_back(make_pair((const void*)padding.data(), padding.size()));
+    blocks.push_back(make_pair((const void*)&phi[0], phi.size() * sizeof(float)));
+    return writeFileAtomically(binaryFileName, blocks);
+}
@@ -0,0 +1,96 @@
+#ifndef MODESFILE_H
+#define MODESFILE_H
+
+#include <string>
+#include "MappedFile.h"
+
+// Binary modes file, version 1 (little-endian):
+//   ModesFileHeader
+//   float eigenValues[numModes]
+//   (zero padding up to phiOffset, a multiple of 64)
+//   float phi[numVertices][numModes][3]     vertex-major, unscaled
+// The text format is: numModes numVertices eigenValues[numModes] phi[numModes][numVertices][3]
+
+#define MODES_FILE_MAGIC "MODESBIN"
+#define MODES_FILE_VERSION 1
+
+struct ModesFileHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int numModes;
+    unsigned int numVertices;
+    unsigned int phiOffset;     // byte offset of the phi block from the start of the file
+};
+
+// A binary modes file opened through a memory mapping; nothing is read until it's touched.
+// ModalAsset copies the modes out of it into its own sorted, padded (and maybe quantized)
+// storage and then closes it, so the mapping saves parsing the text, but a loaded asset's mode
+// shapes are private memory, not pages shared with other processes.
+class BinaryModesFile {
+public:
+    bool open(const std::string& fileName);
+
+    int numModes() const { return header()->numModes; }
+    int numVertices() const { return header()->numVertices; }
+    const float* eigenValues() const { return (const float*)(file.data() + sizeof(ModesFileHeader)); }
+    // numModes x 3 floats for vertex j
+    const float* phiRow(int j) const {
+        return (const float*)(file.data() + header()->phiOffset) + (size_t)j * numModes() * 3;
+    }
+
+private:
+    const ModesFileHeader* header() const { return (const ModesFileHeader*)file.data(); }
+
+    MappedFile file;
+};
+
+// Truncated SVD phi ~= U * S * V^T of the phi of a modes file, where phi is the
+// (3*numVertices x numModes) matrix of mode shapes. Version 1 (little-endian):
+//   LowRankModesFileHeader
+//   float eigenValues[numModes]            ascending
+//   float U[3 * numVertices][rank]         row 3*j + c is for component c of vertex j
+//   float VS[numModes][rank]               V * S; row i is the mode of eigenValues[i]
+
+#define LOW_RANK_MODES_FILE_MAGIC "MODESSVD"
+#define LOW_RANK_MODES_FILE_VERSION 1
+
+struct LowRankModesFileHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int numModes;
+    unsigned int numVertices;
+    unsigned int rank;
+    int requestedRank;          // what the factorization was asked for (see ModeShapeOptions)
+    float requestedTolerance;
+};
+
+class LowRankModesFile {
+public:
+    bool open(const std::string& fileName);
+
+    const LowRankModesFileHeader& header() const { return *(const LowRankModesFileHeader*)file.data(); }
+    const float* eigenValues() const { return (const float*)(file.data() + sizeof(LowRankModesFileHeader)); }
+    const float* U() const { return eigenValues() + header().numModes; }
+    const float* VS() const { return U() + (size_t)3 * header().numVertices * header().rank; }
+
+private:
+    MappedFile file;
+};
+
+bool writeLowRankModesFile(const std::string& fileName, const LowRankModesFileHeader& header,
+                           const float* eigenValues, const float* U, const float* VS);
+
+// the file the low-rank factorization of a modes file is saved to
+std::string lowRankModesFileName(const std::string& modesFileName);
+
+// whether fileName is a binary modes file of the current version whose size matches its
+// header; an older or truncated one is not, so it gets converted again
+bool isBinaryModesFile(const std::string& fileName);
+
+// converts a text modes file to the binary format
+bool convertModesFile(const std::string& textFileName, const std::string& binaryFileName);
+
+// the binary file a text modes file is converted to
+std::string binaryModesFileName(const std::string& textFileName);
+
+#endif
@@ -0,0 +1,334 @@
+#include "ObjFile.h"
+#include "MappedFile.h"
+#include <string.h>
+#include <math.h>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// The parser works on the whole file mapped into memory: a pre-scan counts the v and f lines so
+// the arrays are allocated once, then each line is parsed in place. (std::from_chars isn't
+// available in VS2012, hence the hand-written number parsing.)
+
+static inline const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+static inline const char* nextLine(const char* p, const char* end) {
+    const char* newline = (const char*)memchr(p, '\n', end - p);
+    return newline ? newline + 1 : end;
+}
+
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static double powerOf10(int e) {
+    static const double exact[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    return (e <= 22) ? exact[e] : pow(10.0, e);
+}
+
+// parses a decimal number such as -1.25e-3 at p and moves p past it. the digits are gathered in
+// an integer and scaled by an exact power of 10 in double precision, which is more than enough
+// for a float.
+static bool parseFloat(const char*& p, const char* end, float* value) {
+    const char* q = p;
+    bool negative = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+        negative = (*q == '-');
+        q++;
+    }
+    unsigned long long mantissa = 0;
+    int numDigits = 0;      // significant digits in mantissa
+    int exponent = 0;
+    bool anyDigits = false;
+    for (; q < end && isDigit(*q); q++) {
+        anyDigits = true;
+        if (numDigits < 19) {
+            mantissa = mantissa * 10 + (*q - '0');
+            numDigits += (mantissa != 0);
+        } else {
+            exponent++;
+        }
+    }
+    if (q < end && *q == '.') {
+        q++;
+        for (; q < end && isDigit(*q); q++) {
+            anyDigits = true;
+            if (numDigits < 19) {
+                mantissa = mantissa * 10 + (*q - '0');
+                numDigits += (mantissa != 0);
+                exponent--;
+            }
+        }
+    }
+    if (!anyDigits) {
+        return false;
+    }
+    if (q < end && (*q == 'e' || *q == 'E')) {
+        const char* r = q + 1;
+        bool negativeExponent = false;
+        if (r < end && (*r == '-' || *r == '+')) {
+            negativeExponent = (*r == '-');
+            r++;
+        }
+        if (r < end && isDigit(*r)) {
+            int e = 0;
+            for (; r < end && isDigit(*r); r++) {
+                e = min(e * 10 + (*r - '0'), 1000);
+            }
+            exponent += negativeExponent ? -e : e;
+            q = r;
+        }
+    }
+    double v = (double)mantissa;
+    if (mantissa != 0) {
+        v = (exponent < 0) ? v / powerOf10(-exponent) : v * powerOf10(exponent);
+    }
+    *value = (float)(negative ? -v : v);
+    p = q;
+    return true;
+}
+
+static bool parseInt(const char*& p, const char* end, int* value) {
+    const char* q = p;
+    bool negative = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+        negative = (*q == '-');
+        q++;
+    }
+    if (q == end || !isDigit(*q)) {
+        return false;
+    }
+    int v = 0;
+    for (; q < end && isDigit(*q); q++) {
+        v = v * 10 + (*q - '0');
+    }
+    *value = negative ? -v : v;
+    p = q;
+    return true;
+}
+
+// the line type at p: "v", "f", or something else
+static inline bool isLineType(const char* p, const char* end, char type) {
+    return (end - p >= 2 && p[0] == type && (p[1] == ' ' || p[1] == '\t'));
+}
+
+// comments, blank lines and the usual lines that don't affect the geometry
+static bool isIgnoredLine(const char* p, const char* end) {
+    static const char* const ignored[] = { "vt", "vn", "vp", "o", "g", "s", "usemtl", "mtllib" };
+    if (*p == '#' || *p == '\n') {
+        return true;
+    }
+    for (int i = 0; i < sizeof(ignored) / sizeof(ignored[0]); i++) {
+        size_t length = strlen(ignored[i]);
+        if ((size_t)(end - p) > length && memcmp(p, ignored[i], length) == 0 &&
+            (p[length] == ' ' || p[length] == '\t' || p[length] == '\r' || p[length] == '\n')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseObj(const string& fileName, vector<float>* vertices, vector<unsigned int>* indices) {
+    MappedFile file;
+    if (!file.open(fileName)) {
+        return false;
+    }
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+
+    size_t numVertexLines = 0, numFaceLines = 0;
+    for (const char* p = begin; p < end; p = nextLine(p, end)) {
+        p = skipSpaces(p, end);
+        numVertexLines += isLineType(p, end, 'v');
+        numFaceLines += isLineType(p, end, 'f');
+    }
+    vertices->clear();
+    vertices->reserve(3 * numVertexLines);
+    indices->clear();
+    indices->reserve(3 * numFaceLines);
+
+    int numSkipped = 0, numBadVertices = 0, numBadFaces = 0;
+    for (const char* p = begin; p < end; p = nextLine(p, end)) {
+        p = skipSpaces(p, end);
+        if (isLineType(p, end, 'v')) {
+            // a bad vertex is still kept (with 0 for what can't be read) so the face indices after it
+            // still refer to the right vertices
+            p += 2;
+            bool bad = false;
+            for (int c = 0; c < 3; c++) {
+                float x = 0.f;
+                p = skipSpaces(p, end);
+                bad |= !parseFloat(p, end, &x);
+                vertices->push_back(x);
+            }
+            numBadVertices += bad;
+        } else if (isLineType(p, end, 'f')) {
+            // polygon (v0, v1, v2, ...) -> triangles (v0, v1, v2), (v0, v2, v3), ...
+            p += 2;
+            int numVertices = (int)(vertices->size() / 3);
+            size_t faceBegin = indices->size();
+            unsigned int first = 0, previous = 0;
+            int corner = 0;
+            bool bad = false;
+            while (true) {
+                p = skipSpaces(p, end);
+                int index;
+                if (!parseInt(p, end, &index)) {
+                    break;
+                }
+                // skip the /vt and /vn parts
+                while (p < end && (*p == '/' || *p == '-' || isDigit(*p))) {
+                    p++;
+                }
+                // indices start at 1; negative ones count back from the last vertex
+                index = (index < 0) ? numVertices + index : index - 1;
+                if (index < 0 || index >= numVertices) {
+                    bad = true;
+                    break;
+                }
+                if (corner == 0) {
+                    first = index;
+                } else if (corner >= 2) {
+                    indices->push_back(first);
+                    indices->push_back(previous);
+                    indices->push_back(index);
+                }
+                previous = index;
+                corner++;
+            }
+            if (bad || corner < 3) {
+                indices->resize(faceBegin);
+                numBadFaces++;
+            }
+        } else if (p < end && !isIgnoredLine(p, end)) {
+            numSkipped++;
+        }
+    }
+    if (numSkipped > 0) {
+        cout << "Warning: skipped " << numSkipped << " lines of unsupported types in " << fileName << endl;
+    }
+    if (numBadVertices > 0) {
+        cout << "Warning: " << numBadVertices << " bad vertices in " << fileName << endl;
+    }
+    if (numBadFaces > 0) {
+        cout << "Warning: " << numBadFaces << " bad faces in " << fileName << endl;
+    }
+    return true;
+}
+
+static bool readMeshCache(const string& fileName, ofMesh* mesh) {
+    MappedFile file;
+    if (!file.open(fileName)) {
+        return false;
+    }
+    const MeshFileHeader* header = (const MeshFileHeader*)file.data();
+    bool valid = file.size() >= sizeof(MeshFileHeader) &&
+                 memcmp(header->magic, MESH_FILE_MAGIC, 8) == 0 &&
+                 header->version == MESH_FILE_VERSION &&
+                 file.size() == sizeof(MeshFileHeader) +
+                     ((size_t)6 * header->numVertices + (size_t)3 * header->numTriangles) * 4;
+    if (!valid) {
+        cout << fileName << " is not a valid version " << MESH_FILE_VERSION << " mesh file" << endl;
+        return false;
+    }
+    const float* vertices = (const float*)(file.data() + sizeof(MeshFileHeader));
+    const float* normals = vertices + 3 * header->numVertices;
+    const unsigned int* indices = (const unsigned int*)(normals + 3 * header->numVertices);
+
+    mesh->clear();
+    mesh->addVertices((const ofVec3f*)vertices, header->numVertices);
+    mesh->addNormals((const ofVec3f*)normals, header->numVertices);
+    vector<ofIndexType> meshIndices(indices, indices + 3 * header->numTriangles);
+    mesh->addIndices(meshIndices);
+    mesh->setMode(OF_PRIMITIVE_TRIANGLES);
+    return true;
+}
+
+static bool writeMeshCache(const string& fileName, const vector<float>& vertices,
+                           const vector<float>& normals, const vector<unsigned int>& indices) {
+    MeshFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_FILE_MAGIC, 8);
+    header.version = MESH_FILE_VERSION;
+    header.numVertices = vertices.size() / 3;
+    header.numTriangles = indices.size() / 3;
+
+    vector<pair<const void*, size_t> > blocks;
+    blocks.push_back(make_pair((const void*)&header, sizeof(header)));
+    if (!vertices.empty()) {
+        blocks.push_back(make_pair((const void*)&vertices[0], vertices.size() * sizeof(float)));
+        blocks.push_back(make_pair((const void*)&normals[0], normals.size() * sizeof(float)));
+    }
+    if (!indices.empty()) {
+        blocks.push_back(make_pair((const void*)&indices[0], indices.size() * sizeof(unsigned int)));
+    }
+    return writeFileAtomically(fileName, blocks);
+}
+
+bool readObj(const string& fileName, ofMesh* mesh) {
+    string cacheFileName = meshCacheFileName(fileName);
+    long long cacheTime = fileModifiedTime(cacheFileName);
+    if (cacheTime != 0 && cacheTime >= fileModifiedTime(fileName)) {
+        cout << "Reading geometry data from " << cacheFileName << endl;
+        if (readMeshCache(cacheFileName, mesh)) {
+            return true;
+        }
+    }
+
+    cout << "Reading geometry data from " << fileName << endl;
+    vector<float> vertices;
+    vector<unsigned int> indices;
+    if (!parseObj(fileName, &vertices, &indices)) {
+        cout << "Failed to open " << fileName << endl;
+        return false;
+    }
+
+    // area-weighted vertex normals
+    vector<float> normals(vertices.size(), 0.f);
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        ofVec3f v[3];
+        for (int i = 0; i < 3; i++) {
+            const float* vertex = &vertices[3 * indices[t + i]];
+            v[i] = ofVec3f(vertex[0], vertex[1], vertex[2]);
+        }
+        ofVec3f n_area = (v[1] - v[0]).crossed(v[2] - v[0]);
+        for (int i = 0; i < 3; i++) {
+            float* normal = &normals[3 * indices[t + i]];
+            normal[0] += n_area.x;
+            normal[1] += n_area.y;
+            normal[2] += n_area.z;
+        }
+    }
+    for (size_t i = 0; i < normals.size(); i += 3) {
+        ofVec3f n = ofVec3f(normals[i], normals[i + 1], normals[i + 2]).normalize();
+        normals[i] = n.x;
+        normals[i + 1] = n.y;
+        normals[i + 2] = n.z;
+    }
+
+    mesh->clear();
+    int numVertices = vertices.size() / 3;
+    if (numVertices > 0) {
+        mesh->addVertices((const ofVec3f*)&vertices[0], numVertices);
+        mesh->addNormals((const ofVec3f*)&normals[0], numVertices);
+    }
+    vector<ofIndexType> meshIndices(indices.begin(), indices.end());
+    mesh->addIndices(meshIndices);
+    mesh->setMode(OF_PRIMITIVE_TRIANGLES);
+
+    writeMeshCache(cacheFileName, vertices, normals, indices);
+    return true;
+}
+
+string meshCacheFileName(const string& objFileName) {
+    return replaceFileExtension(objFileName, ".mesh");
+}
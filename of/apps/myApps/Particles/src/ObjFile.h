@@ -0,0 +1,33 @@
+#ifndef OBJFILE_H
+#define OBJFILE_H
+
+#include <string>
+
+#include "ofMain.h"
+
+// Binary mesh cache of an .obj file, version 1 (little-endian):
+//   MeshFileHeader
+//   float vertices[numVertices][3]
+//   float normals[numVertices][3]
+//   unsigned int indices[numTriangles][3]
+
+#define MESH_FILE_MAGIC "MESHBIN1"
+#define MESH_FILE_VERSION 1
+
+struct MeshFileHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int numVertices;
+    unsigned int numTriangles;
+};
+
+// Reads a triangle mesh from an .obj file and gives it area-weighted vertex normals. Understands
+// v lines and f lines with v, v/vt, v//vn or v/vt/vn vertices (polygons are split into fans);
+// other lines are skipped. The mesh is cached in a binary file next to the .obj, which is read
+// instead while it's newer than the .obj.
+bool readObj(const std::string& fileName, ofMesh* mesh);
+
+// the binary cache of an .obj file
+std::string meshCacheFileName(const std::string& objFileName);
+
+#endif
@@ -0,0 +1,53 @@
+#include "QualityGovernor.h"
+#include <algorithm>
+#include <math.h>
+
+QualityGovernor::QualityGovernor()
+    :
+    enabled(true),
+    targetLoad(0.25f),
+    minQuality(0.05f),
+    quality(1.f),
+    load(0.f),
+    lastChange(0.f),
+    framesSinceChange(0)
+{}
+
+void QualityGovernor::update(float audioSeconds, float frameSeconds) {
+    if (frameSeconds <= 0.f) {
+        return;
+    }
+    // smooth over a few frames so a single slow frame doesn't cause a cut
+    load += 0.5f * (audioSeconds / frameSeconds - load);
+    framesSinceChange++;
+    if (!enabled) {
+        // every mode is voiced while it's off (see modeCap), so that's the quality shown; it
+        // picks up from there when it's turned back on
+        quality = 1.f;
+        lastChange = 0.f;
+        return;
+    }
+
+    float newQuality = quality;
+    if (load > targetLoad && framesSinceChange >= 3) {
+        // over budget: scale the work down in proportion to the overload (after giving the
+        // smoothed load a few frames to reflect the previous change)
+        newQuality = quality * std::max(0.5f, 0.95f * targetLoad / load);
+    } else if (load < 0.7f * targetLoad && framesSinceChange >= 5) {
+        // well within budget: creep back up
+        newQuality = quality * 1.1f;
+    }
+    newQuality = std::min(std::max(newQuality, minQuality), 1.f);
+    if (newQuality != quality) {
+        lastChange = newQuality - quality;
+        quality = newQuality;
+        framesSinceChange = 0;
+    }
+}
+
+int QualityGovernor::modeCap(int numModes) const {
+    if (!enabled) {
+        return numModes;
+    }
+    return std::max((int)ceilf(quality * numModes), 1);
+}
@@ -0,0 +1,28 @@
+#ifndef QUALITYGOVERNOR_H
+#define QUALITYGOVERNOR_H
+
+// Feedback controller for the cost of audio synthesis. Each frame it's told how long the audio
+// path took and how much audio time that frame covered, and it adjusts "quality", the fraction
+// of each body's modes that may be voiced, to keep the audio path within targetLoad of the frame.
+// Cuts are fast (multiplicative) and recovery is slow, so overload turns into fewer modes rather
+// than audio dropouts.
+class QualityGovernor {
+public:
+    QualityGovernor();
+
+    void update(float audioSeconds, float frameSeconds);
+
+    // max number of modes voiced for a body that has numModes active modes
+    int modeCap(int numModes) const;
+
+    bool enabled;
+    float targetLoad;       // fraction of the frame the audio path may take
+    float minQuality;
+
+    float quality;          // in [minQuality, 1]
+    float load;             // smoothed fraction of the frame taken by the audio path
+    float lastChange;       // last adjustment made to quality
+    int framesSinceChange;
+};
+
+#endif
@@ -1,55 +1,18 @@
 #include "RigidBody.h"
+#include "ModeScheduler.h"
 #include <assert.h>
 #include <iostream>
 #include <fstream>
 
-static void readObj(const string& fileName, float scale, ofMesh* mesh) {
-    cout << "Reading geometry data from " << fileName << endl;
-    ifstream file;
-    file.open(fileName, ios::in);
-    if (!file.is_open()) {
-        cout << "Failed to open " << fileName << endl;
-        return;
-    }
-    mesh->clear();
-    vector<ofVec3f> normals;
-    string line;
-    while (getline(file, line)) {
-        char c;
-        istringstream iss(line);
-        iss >> c;
-        if (c == '#') continue;
-        else if (c == 'v') {
-            ofVec3f v;
-            iss >> v.x >> v.y >> v.z;
-            mesh->addVertex(v * scale);
-            normals.emplace_back(0.f, 0.f, 0.f);
-        } else if (c == 'f') {
-            int indices[3];
-            iss >> indices[0] >> indices[1] >> indices[2];
-            ofVec3f v[3];
-            for (int i = 0; i < 3; i++) {
-                v[i] = mesh->getVertex(--indices[i]);
-            }
-            ofVec3f n_area = (v[1] - v[0]).crossed(v[2] - v[0]);
-            for (int i = 0; i < 3; i++) {
-                normals[indices[i]] += n_area;
-            }
-            mesh->addTriangle(indices[0], indices[1], indices[2]);
-        } else{
-            std::cout << "Warning: unrecognized line type " << c << endl;
-        }
-    }
-    file.close();
-    for (int i = 0; i < normals.size(); i++) {
-        normals[i].normalize();
-    }
-    mesh->addNormals(normals);
-    mesh->setMode(OF_PRIMITIVE_TRIANGLES);
-}
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define RIGIDBODY_X86
+#include <emmintrin.h>
+#endif
 
-void RigidBody::readModes(const string& fileName, float E, float nu, float rho, float sizeScale,
-                          vector<vector<ofVec3f>>* phi, vector<float>* omega) {
+// picks the modes of the asset this body uses and scales their frequencies to its size and
+// material: the asset's modes are sorted by frequency, so the modes inside the audible band
+// are the contiguous range [modeBase, modeBase + omega.size())
+void RigidBody::selectModes(float E, float nu, float rho, const AudibleBand& band) {
 
     float modesG = E / (2.f * (1 + nu));
     float materialG = material.E / (2.f * (1 + material.nu));
@@ -58,218 +21,75 @@ void RigidBody::readModes(const string& fileName, float E, float nu, float rho,
     float densityScale = sqrtf(rho / material.rho);
 
     float omegaScale = stiffnessScale * densityScale / sizeScale;
-    float phiScale = densityScale / sqrtf(sizeScale*sizeScale*sizeScale);
-
-    cout << "Reading modes data from " << fileName << endl;
-    ifstream file;
-    file.open(fileName, ios::in);
-    if (!file.is_open()) {
-        cout << "Failed to open " << fileName << endl;
-        return;
-    }
-
-    phi->clear();
-    omega->clear();
-    int numModes, numVertices;
-    file >> numModes;
-    file >> numVertices;
-    float omegaMax = 0.f;
-    float omegaMin = numeric_limits<float>::max();
-    vector<bool> modeIsUnderdamped(numModes);
+    phiScale = densityScale / sqrtf(sizeScale*sizeScale*sizeScale);
+
+    // modes above Nyquist would alias and modes outside the audible band can't be heard, so
+    // this body never runs them
+    float omegaLow = 2.f * PI * band.minHz;
+    float omegaHigh = 2.f * PI * min(band.maxHz, 0.5f * band.sampleRate);
+    int numModes = asset->numModes();
+    omega.clear();
+    modeBase = 0;
     for (int i = 0; i < numModes; i++) {
-        float eigenValue;
-        file >> eigenValue;
-        // only record the underdamped modes
-        float wi = omegaScale * sqrtf(eigenValue);
-        float xii = 0.5f * (alpha / wi + beta*wi);
-        modeIsUnderdamped[i] = true;    // (0.f < xii && xii < 1.f);
-        if (modeIsUnderdamped[i]) {
-            omega->push_back(wi);
-            if (wi > omegaMax) {
-                omegaMax = wi;
-            }
-            if (wi < omegaMin) {
-                omegaMin = wi;
+        // overdamped modes are kept here; updateModeCoefs leaves them inactive
+        float wi = omegaScale * sqrtf(asset->eigenValues[i]);
+        bool audible = (omegaLow <= wi && wi <= omegaHigh);
+        if (audible) {
+            if (omega.empty()) {
+                modeBase = i;
             }
+            assert(modeBase + (int)omega.size() == i);
+            omega.push_back(wi);
         }
     }
-    for (int i = 0; i < numModes; i++) {
-        // only record the underdamped modes
-        if (modeIsUnderdamped[i]) {
-            phi->push_back(vector<ofVec3f>());
-            vector<ofVec3f>& phi_i = phi->back();
-            for (int j = 0; j < numVertices; j++) {
-                float x, y, z;
-                ofVec3f phi_i_j;
-                file >> phi_i_j.x >> phi_i_j.y >> phi_i_j.z;
-                phi_i.push_back(phiScale * phi_i_j);
-            }
-        } else {
-            for (int j = 0; j < numVertices; j++) {
-                float unused;
-                file >> unused >> unused >> unused;
-            }
-        }
+    int numDiscarded = numModes - omega.size();
+    cout << omega.size() << " modes kept; " << numDiscarded << " modes discarded (outside "
+         << band.minHz << "-" << min(band.maxHz, 0.5f * band.sampleRate) << " hz)" << endl;
+    if (numDiscarded > 0) {
+        // per-mode state of this body: omega, qq[2], modeA/B/Gain/Forces, modeInvSinSq and
+        // modeAudibility; modeVoice and modeSelected; and, while voiced, voiceModes and the 5 voice arrays
+        size_t bytesPerMode = 9 * sizeof(float) + 2 * sizeof(unsigned char) + sizeof(int) + 5 * sizeof(float);
+        cout << "Saved " << (3 * numDiscarded) << " flops per audio sample and "
+             << (numDiscarded * bytesPerMode) << " bytes of mode state" << endl;
     }
-    file.close();
-    cout << omega->size() << " underdamped modes; " << (numModes-omega->size()) << " modes discarded" << endl;
-    cout << "Min freq: " << (omegaMin/(2.f*PI)) << " hz   Max freq: " << (omegaMax/(2.f*PI)) << " hz" << endl;
-}
-
-/*static float signedVolume(const ofMeshFace& tri) {
-    const ofVec3f& v1 = tri.getVertex(0);
-    const ofVec3f& v2 = tri.getVertex(1);
-    const ofVec3f& v3 = tri.getVertex(2);
-    float v321 = v3.x * v2.y * v1.z;
-    float v231 = v2.x * v3.y * v1.z;
-    float v312 = v3.x * v1.y * v2.z;
-    float v132 = v1.x * v3.y * v2.z;
-    float v213 = v2.x * v1.y * v3.z;
-    float v123 = v1.x * v2.y * v3.z;
-    return (-v321 + v231 + v312 - v132 - v213 + v123) / 6.f;
-}*/
-
-// computes integral x^p*y^q*z^r dxdydz over the tetrahedron formed by a face and the
-// origin, where two of p,q,r are 0. The param "coord" determines which of x,y,z has the nonzero
-// exponent (0=x, 1=y, 2=z), and "pow" determines that exponent, which can be 0, 1, or 2.
-// http://research.microsoft.com/en-us/um/people/chazhang/publications/icip01_ChaZhang.pdf
-static float signedMoment(const ofMeshFace& tri, int coord, int pow) {
-    assert(0 <= coord && coord < 3);
-    float x[3], y[3], z[3];
-    for (int i = 0; i < 3; i++) {
-        x[i] = tri.getVertex(i)[(coord) % 3];
-        y[i] = tri.getVertex(i)[(coord + 1) % 3];
-        z[i] = tri.getVertex(i)[(coord + 2) % 3];
-    }
-    float M000 = (-x[2] * y[1] * z[0]
-        + x[1] * y[2] * z[0]
-        + x[2] * y[0] * z[1]
-        - x[0] * y[2] * z[1]
-        - x[1] * y[0] * z[2]
-        + x[0] * y[1] * z[2]) / 6.f;
-    switch (pow) {
-    case 0:
-        return M000;    // this is just the signed volume of the tetrahedron
-        break;
-    case 1:
-        return 0.25f * (x[0] + x[1] + x[2]) * M000;
-        break;
-    case 2:
-        return 0.1f * (x[0] * x[0] + x[1] * x[1] + x[2] * x[2]
-            + x[0] * x[1] + x[1] * x[2] + x[2] * x[0])
-            * M000;
-        break;
-    default:
-        assert(false);
-        return 0.f;
-        break;
-    }
-}
-
-// computes integrals x^p*y^q*z^r dxdydz over a face tetrahedron where p+q+r=2.
-// http://www.geometrictools.com/Documentation/PolyhedralMassProperties.pdf
-static void signedMoment2(const ofMeshFace& tri,
-    //float* M,
-    //float* Mx, float* My, float* Mz,
-    float* Mxx, float* Myy, float* Mzz,
-    float* Mxy, float* Myz, float* Mxz) {
-    ofVec3f V[3];
-    for (int i = 0; i < 3; i++) {
-        V[i] = tri.getVertex(i);
-    }
-    ofVec3f E1 = V[1] - V[0];
-    ofVec3f E2 = V[2] - V[0];
-    ofVec3f delta = E1.crossed(E2);
-
-    // f1[0] = f1(x), f1[1] = f1(y), etc
-    const int X = 0;
-    const int Y = 1;
-    const int Z = 2;
-    float f1[3];
-    float f2[3];
-    float f3[3];
-    float g[3][3];
-    for (int w = 0; w < 3; w++) {   // iterating over x, y, z
-        float w0 = V[0][w];
-        float w1 = V[1][w];
-        float w2 = V[2][w];
-        f1[w] = w0 + w1 + w2;
-        f2[w] = w0*w0 + w1*(w0 + w1) + w2*f1[w];
-        f3[w] = w0*w0*w0 + w1*(w0*w0 + w0*w1 + w1*w1) + w2*f2[w];
-        for (int i = 0; i < 3; i++) {
-            float wi = V[i][w];
-            g[i][w] = f2[w] + wi*(f1[w] + wi);
-        }
+    if (!omega.empty()) {
+        cout << "Min freq: " << (omega.front()/(2.f*PI)) << " hz   Max freq: " << (omega.back()/(2.f*PI)) << " hz" << endl;
     }
-    //*M = (delta[0] / 6.f) * f1[X];
-    //*Mx = 0.5f * (delta[0] / 12.f) * f2[X];
-    //*My = 0.5f * (delta[1] / 12.f) * f2[Y];
-    //*Mz = 0.5f * (delta[2] / 12.f) * f2[Z];
-    *Mxx = (1.f / 3.f) * (delta[0] / 20.f) * f3[X];
-    *Myy = (1.f / 3.f) * (delta[1] / 20.f) * f3[Y];
-    *Mzz = (1.f / 3.f) * (delta[2] / 20.f) * f3[Z];
-    *Mxy = 0.5f * (delta[0] / 60.f) * (V[0].y*g[0][X] + V[1].y*g[1][X] + V[2].y*g[2][X]);
-    *Myz = 0.5f * (delta[1] / 60.f) * (V[0].z*g[0][Y] + V[1].z*g[1][Y] + V[2].z*g[2][Y]);
-    *Mxz = 0.5f * (delta[2] / 60.f) * (V[0].x*g[0][Z] + V[1].x*g[1][Z] + V[2].x*g[2][Z]);
 }
 
 void RigidBody::computeMIBodyIBodyInv() {
-    // compute zeroth and first order moments
-    float M = 0.f;                          // volume
-    float Mx = 0.f, My = 0.f, Mz = 0.f;     // center of mass
-    const vector<ofMeshFace>* triangles = &mesh.getUniqueFaces();
-    for (const ofMeshFace& tri : *triangles) {
-        M += signedMoment(tri, 0, 0);
-        Mx += signedMoment(tri, 0, 1);
-        My += signedMoment(tri, 1, 1);
-        Mz += signedMoment(tri, 2, 1);
-    }
-
-    m = material.rho * abs(M);  // mass
-    ofVec3f centerOfMass = ofVec3f(Mx, My, Mz) / M;
-
-    // move mesh so its center of mass is at origin
-    for (int i = 0; i < mesh.getNumVertices(); i++) {
-        mesh.setVertex(i, mesh.getVertex(i) - centerOfMass);
-    }
-    triangles = &mesh.getUniqueFaces();
-
-    // compute second-order moments
-    float Mxx = 0.f, Myy = 0.f, Mzz = 0.f;
-    float Mxy = 0.f, Myz = 0.f, Mxz = 0.f;
-    for (const ofMeshFace& tri : *triangles) {
-        float mxx, myy, mzz, mxy, myz, mxz;
-        signedMoment2(tri, &mxx, &myy, &mzz, &mxy, &myz, &mxz);
-        Mxx += mxx, Myy += myy, Mzz += mzz;
-        Mxy += mxy, Myz += myz, Mxz += mxz;
-    }
-
-    float Ixx = material.rho * (Myy + Mzz);
-    float Iyy = material.rho * (Mzz + Mxx);
-    float Izz = material.rho * (Mxx + Myy);
-    //float Ixy = material.density * Mxy;
-    //float Iyz = material.density * Myz;
-    //float Ixz = material.density * Mxz;
-    /*IBody = ofMatrix3x3(Ixx, -Ixy, -Ixz,    // moment of inertia
-    -Ixy, Iyy, -Iyz,
-    -Ixz, -Iyz, Izz);
-    IBodyInv = IBody.inverse();*/
-    //Ixx *= 100.f;
-    IBody = ofMatrix3x3(Ixx, 0.f, 0.f,    // assuming Ixy,Iyz,Ixz=0
-        0.f, Iyy, 0.f,
-        0.f, 0.f, Izz);
-    IBodyInv = ofMatrix3x3(1.f / Ixx, 0.f, 0.f,    // assuming Ixy,Iyz,Ixz=0
-        0.f, 1.f / Iyy, 0.f,
-        0.f, 0.f, 1.f / Izz);
+    // the asset's moments are for unit size: volume scales with s^3, second moments with s^5
+    float s2 = sizeScale * sizeScale;
+    float s3 = s2 * sizeScale;
+    float s5 = s3 * s2;
+    ofVec3f M = s5 * asset->principalMoments;
+
+    m = material.rho * abs(s3 * asset->volume);  // mass
+
+    // moments of inertia about the principal axes
+    IPrincipal = material.rho * ofVec3f(M.y + M.z, M.z + M.x, M.x + M.y);
+
+    // IBody = A * diag(IPrincipal) * A^T
+    const ofMatrix3x3& A = asset->principalAxes;
+    ofMatrix3x3 D(IPrincipal.x, 0.f, 0.f,
+                  0.f, IPrincipal.y, 0.f,
+                  0.f, 0.f, IPrincipal.z);
+    ofMatrix3x3 DInv(1.f / IPrincipal.x, 0.f, 0.f,
+                     0.f, 1.f / IPrincipal.y, 0.f,
+                     0.f, 0.f, 1.f / IPrincipal.z);
+    IBody = A * D * A.transposed();
+    IBodyInv = A * DInv * A.transposed();
     IInv = IBodyInv;
 }
 
 
 RigidBody::RigidBody(const string& modesFileName, float E, float nu, float rho, float alpha, float beta,
                      const string& objFileName, const Material& material, float sizeScale,
-                     bool isSphere)
+                     bool isSphere, const AudibleBand& band, const ModeShapeOptions& modeShapes)
     :
+    asset(ModalAsset::load(objFileName, modesFileName, modeShapes)),
     material(material),
+    sizeScale(sizeScale),
     x(0.f, 0.f, 0.f),
     q(0.f, 0.f, 0.f, 1.f),
     P(0.f, 0.f, 0.f),
@@ -282,37 +102,53 @@ RigidBody::RigidBody(const string& modesFileName, float E, float nu, float rho,
     beta(beta),
     isSphere(isSphere)
 {
-    readObj(objFileName, sizeScale, &mesh);
-
     computeMIBodyIBodyInv();
 
-    readModes(modesFileName, E, nu, rho, sizeScale, &phi, &omega);
-    assert(phi.size() == omega.size());
-    assert(phi[0].size() == mesh.getNumVertices());
+    selectModes(E, nu, rho, band);
     
     // initialize modal amplitude vectors to 0s
-    for (int k = 0; k < 3; k++) {
-        qq[k] = vector<float>(omega.size(), 0.f);
+    int numModesPadded = modalBankPadded(omega.size());
+    for (int k = 0; k < 2; k++) {
+        qq[k] = AlignedFloats(numModesPadded, 0.f);
     }
-    qkAt = 0;
 
 
     // determine sphere radius if this is a sphere
     if (isSphere) {
-        r = 0.f;
-        for (int i = 0; i < mesh.getNumVertices(); i++) {
-            const ofVec3f& vertex = mesh.getVertex(i);
-            float dist = vertex.length();
-            if (dist > r) {
-                r = dist;
-            }
-        }
+        r = sizeScale * asset->radius;
+    }
+
+    for (int k = 0; k < 6; k++) {
+        supportHints[k] = 0;
     }
+    hullVisitCount = 0;
+    vertexCacheCount = 0;
 
+    asleep = false;
+    stillTime = 0.f;
+
+
+    pendingExcitation = false;
+    modeSelected = vector<unsigned char>(omega.size(), 0);
+
+    audioSleepThreshold = 1e-11f;
+    audioAsleep = true;     // nothing to play until the first impulse
+    audioSleepCount = 0;
+    audioWakeCount = 0;
 
     // FOR TUNING DAMPING PARAMS
     topModes = true;
     nModesOnly = 94;
+
+    // build the resonator coefficient table for the band's sample rate; it's rebuilt if
+    // stepAudio is called with a different time-step
+    modeForces = AlignedFloats(numModesPadded, 0.f);
+    if (asset->storage == MODE_SHAPES_LOW_RANK) {
+        reducedForces = Eigen::VectorXf::Zero(asset->phiU.cols());
+    } else if (asset->storage != MODE_SHAPES_FLOAT) {
+        assetForces = AlignedFloats(asset->modeScale.size(), 0.f);
+    }
+    updateModeCoefs(1.f / band.sampleRate);
 }
 
 void RigidBody::rotate(float rad, const ofVec3f& axis) {
@@ -336,7 +172,7 @@ void RigidBody::step(float dt) {
     // update q, R, IInv using w
     float wMag = w.length();
     float halfAngle = 0.5f * dt * wMag;
-    ofVec3f axis = w / wMag;
+    ofVec3f axis = (wMag > 0.f) ? w / wMag : ofVec3f(0.f, 0.f, 0.f);  // no spin: dq is the identity
     float sin = sinf(halfAngle);
     ofQuaternion dq = ofQuaternion(sin*axis.x, sin*axis.y, sin*axis.z, cosf(halfAngle));
     //q = dq * q;
@@ -353,101 +189,380 @@ void RigidBody::stepW(float dt) {
     // update w using Euler's equation
     assert(dt > 0.f);
     // not quite backwards euler???
-    ofVec3f wBody = RInv * w;
+    // Euler's equations are written in the principal frame, where the inertia is diagonal
+    const ofMatrix3x3& axes = asset->principalAxes;
+    ofVec3f wBody = axes.transposed() * (RInv * w);
     //ofVec3f tauBody = RInv * (dL / dt);
     float w1 = wBody.x;
     float w2 = wBody.y;
     float w3 = wBody.z;
-    float I1 = IBody.a;
-    float I2 = IBody.e;
-    float I3 = IBody.i;
+    float I1 = IPrincipal.x;
+    float I2 = IPrincipal.y;
+    float I3 = IPrincipal.z;
     ofMatrix3x3 A(I1 / dt, (I3 - I2)*w3, 0.f,
                   0.f, I2 / dt, (I1 - I3)*w1,
                   (I2 - I1)*w2, 0.f, I3 / dt);
     ofVec3f b(I1*w1 / dt, I2*w2 / dt, I3*w3 / dt);
     wBody = A.inverse() * b;// (b + tauBody);
-    w = R * wBody;
+    w = R * (axes * wBody);
+}
+
+// the coefficient table must be rebuilt if the time-step, the damping params or the
+// range of active modes has changed since it was built (alpha, beta, topModes and nModesOnly
+// are tweaked at runtime by key presses, and more modes are usable as the asset loads).
+bool RigidBody::modeCoefsStale(float h) const {
+    return (h != coefH || alpha != coefAlpha || beta != coefBeta ||
+            topModes != coefTopModes || nModesOnly != coefNModesOnly ||
+            asset->numModesLoaded() != coefModesLoaded);
+}
+
+void RigidBody::updateModeCoefs(float h) {
+    int numModes = omega.size();
+    int numModesPadded = modalBankPadded(numModes);
+    modeA.assign(numModesPadded, 0.f);
+    modeB.assign(numModesPadded, 0.f);
+    modeGain.assign(numModesPadded, 0.f);
+    modeInvSinSq.assign(numModesPadded, 0.f);
+    modeAudibility.assign(numModesPadded, 0.f);
+    modeVoice.assign(numModes, VOICE_OFF);
+    activeBegin = numModes;
+    activeEnd = 0;
+    // modes whose shapes haven't been loaded yet stay inactive
+    int modesLoaded = asset->numModesLoaded();
+    for (int i = 0; i < numModes; i++) {
+        float wi = omega[i];
+        float xii = 0.5f * (alpha/wi + beta*wi);
+        if (modeBase + i < modesLoaded && 0.f < xii && xii < 1.f &&
+            ((topModes && i >= numModes-nModesOnly) || (!topModes && i < nModesOnly))) {
+            float wdi = wi * sqrtf(1 - xii*xii);
+
+            float ei = exp(-xii*wi*h);
+            float thetai = wdi * h;
+            float gammai = asinf(xii);
+
+            modeA[i] = 2.f*ei*cosf(thetai);
+            modeB[i] = ei*ei;
+            modeGain[i] = 2.f*(ei*cosf(thetai + gammai) - ei*ei*cosf(2.f*thetai + gammai)) / (3.f*wi*wdi);
+            float sinThetai = sinf(thetai);
+            modeInvSinSq[i] = 1.f / (sinThetai*sinThetai);
+            modeAudibility[i] = audibilityWeight(wdi / (2.f * PI));
+            modeVoice[i] = VOICE_ON;
+
+            activeBegin = min(activeBegin, i);
+            activeEnd = i + 1;
+        } else {
+            // inactive modes are held at 0
+            qq[0][i] = 0.f;
+            qq[1][i] = 0.f;
+        }
+    }
+    if (activeBegin >= activeEnd) {
+        activeBegin = activeEnd = 0;
+    }
+    activeBegin -= activeBegin % MODAL_BANK_WIDTH;
+
+    coefH = h;
+    coefAlpha = alpha;
+    coefBeta = beta;
+    coefTopModes = topModes;
+    coefNModesOnly = nModesOnly;
+    coefModesLoaded = modesLoaded;
 }
 
 int RigidBody::stepAudio(float dt, const vector<VertexImpulse>& impulses, float dt_q, float* qSum) {
+    int qsToCompute = prepareAudio(dt, impulses, dt_q);
+    synthesizeAudio(qsToCompute, qSum);
+    return qsToCompute;
+}
+
+int RigidBody::prepareAudio(float dt, const vector<VertexImpulse>& impulses, float dt_q) {
 
     float h = dt_q;
+    int qsToCompute = max((int)(dt / h), 1);
+
+    pendingExcitation = false;
+    if (audioAsleep) {
+        if (impulses.empty()) {
+            return qsToCompute;     // silent; nothing to add to qSum
+        }
+        audioAsleep = false;
+        audioWakeCount++;
+    }
+
+    if (modeCoefsStale(h)) {
+        updateModeCoefs(h);
+    }
 
     // all impulses will be spread out over the first time-step of q as constant forces.
-    // convert the impulses to forces in bodyspace.
-    vector<ofVec3f> forces;
-    for (const VertexImpulse& vim : impulses) {
-        forces.push_back((RInv * vim.impulse) / h);
+    // convert the impulses to forces in bodyspace and project them onto the active modes:
+    // each impulse is one small GEMV against the (modes x 3) row of phi at its vertex.
+    // only the active modes are read from the asset: the ones past them may still be loading.
+    // a body with no active modes (all culled from the band, or none read) has nothing to excite.
+    if (!impulses.empty() && !omega.empty() && activeBegin < activeEnd) {
+        int numForces = modalBankPadded(activeEnd) - activeBegin;
+        int numActive = activeEnd - activeBegin;
+        Eigen::Map<Eigen::VectorXf> F(&modeForces[activeBegin], numForces);
+        if (asset->storage == MODE_SHAPES_FLOAT) {
+            F.setZero();
+            for (const VertexImpulse& vim : impulses) {
+                ofVec3f force = (RInv * vim.impulse) * (phiScale / h);
+                Eigen::Map<const Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor>>
+                    phi_j(&asset->phi(vim.vertex, 3 * (modeBase + activeBegin)), numActive, 3);
+                F.head(numActive).noalias() += phi_j * Eigen::Vector3f(force.x, force.y, force.z);
+            }
+        } else if (asset->storage == MODE_SHAPES_LOW_RANK) {
+            // with phi ~= U * (VS)^T, project the impulses onto the rank-r basis U first
+            // (3r flops each) and expand that to the modes once
+            reducedForces.setZero();
+            for (const VertexImpulse& vim : impulses) {
+                ofVec3f force = (RInv * vim.impulse) * (phiScale / h);
+                reducedForces.noalias() += asset->phiU.middleRows(3 * vim.vertex, 3).transpose() *
+                                           Eigen::Vector3f(force.x, force.y, force.z);
+            }
+            F.noalias() = asset->phiVS.middleRows(modeBase + activeBegin, numForces) * reducedForces;
+        } else {
+            // 16-bit mode shapes are projected a whole block of the asset's modes at a time,
+            // then scaled and shifted onto this body's modes
+            int assetBegin = modeBase + activeBegin;
+            int blockBegin = assetBegin - assetBegin % MODAL_BANK_WIDTH;
+            int blockEnd = modalBankPadded(modeBase + activeEnd);
+            fill(assetForces.begin() + blockBegin, assetForces.begin() + blockEnd, 0.f);
+            for (const VertexImpulse& vim : impulses) {
+                ofVec3f force = (RInv * vim.impulse) * (phiScale / h);
+                projectQuantizedModes(asset->storage, asset->quantizedRow(vim.vertex), &force.x,
+                                      blockBegin, blockEnd, &assetForces[0]);
+            }
+            F.setZero();
+            F.head(numActive).array() = Eigen::Map<const Eigen::ArrayXf>(&assetForces[assetBegin], numActive) *
+                                        Eigen::Map<const Eigen::ArrayXf>(&asset->modeScale[assetBegin], numActive);
+        }
+        // fold the excitation gain in so the resonator bank only has to add it
+        F.array() *= Eigen::Map<const Eigen::ArrayXf>(&modeGain[activeBegin], numForces);
+        pendingExcitation = true;
     }
 
-    // compute q vectors and their sums
-    int qsToCompute = max((int)(dt / h), 1);
-    for (int k = 0; k < qsToCompute; k++) {
-        qkAt = (qkAt + 1) % 3;
-        const vector<float>& qk1 = qq[(qkAt + 2) % 3];
-        const vector<float>& qk2 = qq[(qkAt + 1) % 3];
-        vector<float>& qk = qq[qkAt];
-        
-        float qkSum = 0.f;
-        for (int i = 0; i < qk.size(); i++) {
-            float wi = omega[i];
-            float xii = 0.5f * (alpha/wi + beta*wi);
-            //if (0.f < xii && xii < 1.f) {    // underdamped (overdamped frequencies were already removed)
-//if (i >= qk.size() - topNModesOnly) {
-if (0.f < xii && xii < 1.f &&
-    ((topModes && i >= qk.size()-nModesOnly) || (!topModes && i < nModesOnly))) {
-                float wdi = wi * sqrtf(1 - xii*xii);
-
-                float ei = exp(-xii*wi*h);
-                float thetai = wdi * h;
-                float gammai = asinf(xii);
-
-                qk[i] = 2.f*ei*cosf(thetai)*qk1[i] - ei*ei*qk2[i];
-
-                // impulses are applied evenly over the first time-step; no force applied for other time-steps
-                if (k == 0) {
-                    float phi_i_dot_F = 0.f;
-                    for (int j = 0; j < impulses.size(); j++) {
-                        int vertex = impulses[j].vertex;
-                        ofVec3f force = forces[j];
-                        phi_i_dot_F += phi[i][vertex].dot(force);
-                    }
-                    qk[i] += (2.f*(ei*cosf(thetai + gammai) - ei*ei*cosf(2.f*thetai + gammai)) / (3.f*wi*wdi))
-                        * (phi_i_dot_F);
-                }
-} else {
-    qk[i] = 0.f;
+    return qsToCompute;
 }
-            //} else {
-            //    qk[i] = 0.f;
-            //}
-            assert(!isnan(qk[i]));
-            qkSum += qk[i];
+
+void RigidBody::synthesizeAudio(int qsToCompute, float* qSum) {
+    if (audioAsleep) {
+        return;
+    }
+
+    // gather the voiced modes into dense arrays. fading modes get no new excitation and their
+    // decay is sped up so they drop by 60 dB over this call instead of being cut off
+    const float fade = powf(1e-3f, 1.f / qsToCompute);
+    voiceModes.clear();
+    for (int i = activeBegin; i < activeEnd; i++) {
+        if (modeVoice[i] != VOICE_OFF) {
+            voiceModes.push_back(i);
         }
+    }
+    const int numVoices = voiceModes.size();
+    const int numVoicesPadded = modalBankPadded(numVoices);
+    voiceA.assign(numVoicesPadded, 0.f);
+    voiceB.assign(numVoicesPadded, 0.f);
+    voiceU.assign(numVoicesPadded, 0.f);
+    voiceQ1.assign(numVoicesPadded, 0.f);
+    voiceQ2.assign(numVoicesPadded, 0.f);
+    for (int v = 0; v < numVoices; v++) {
+        int i = voiceModes[v];
+        if (modeVoice[i] == VOICE_FADING) {
+            voiceA[v] = modeA[i] * fade;
+            voiceB[v] = modeB[i] * fade*fade;
+        } else {
+            voiceA[v] = modeA[i];
+            voiceB[v] = modeB[i];
+            voiceU[v] = pendingExcitation ? modeForces[i] : 0.f;
+        }
+        voiceQ1[v] = qq[0][i];
+        voiceQ2[v] = qq[1][i];
+    }
 
-        qSum[k] += qkSum;
+    // compute q vectors and their sums; the impulses are applied evenly over the first
+    // time-step, no force is applied for the other time-steps
+    if (numVoices > 0) {
+        runResonatorBank(&voiceA[0], &voiceB[0], pendingExcitation ? &voiceU[0] : NULL,
+                         &voiceQ1[0], &voiceQ2[0], 0, numVoices, qsToCompute, qSum);
+    }
+    pendingExcitation = false;
+
+    // scatter the new state back; faded modes are done
+    for (int v = 0; v < numVoices; v++) {
+        int i = voiceModes[v];
+        if (modeVoice[i] == VOICE_FADING) {
+            modeVoice[i] = VOICE_OFF;
+            qq[0][i] = 0.f;
+            qq[1][i] = 0.f;
+        } else {
+            qq[0][i] = voiceQ1[v];
+            qq[1][i] = voiceQ2[v];
+        }
     }
 
-    return qsToCompute;
+    // put the resonator bank to sleep once it has decayed below audibility
+    if (modalEnergy() < audioSleepThreshold*audioSleepThreshold) {
+        std::fill(qq[0].begin(), qq[0].end(), 0.f);
+        std::fill(qq[1].begin(), qq[1].end(), 0.f);
+        audioAsleep = true;
+        audioSleepCount++;
+    }
+}
+
+float RigidBody::modeLoudnessSq(int i) const {
+    float qk = qq[0][i];
+    float qk1 = qq[1][i];
+    float u = pendingExcitation ? modeForces[i] : 0.f;
+    return (qk*qk - modeA[i]*qk*qk1 + modeB[i]*qk1*qk1 + u*u) * modeInvSinSq[i];
+}
+
+void RigidBody::applyModeSelection() {
+    for (int i = activeBegin; i < activeEnd; i++) {
+        if (modeSelected[i]) {
+            modeVoice[i] = VOICE_ON;
+        } else if (modeVoice[i] == VOICE_ON) {
+            modeVoice[i] = VOICE_FADING;
+        }
+    }
+}
+
+float RigidBody::modalEnergy() const {
+    // for a decaying sinusoid q(k) = A e^k cos(k theta + phase), the envelope at sample k is
+    // A_k^2 = (q(k)^2 - a q(k) q(k-1) + b q(k-1)^2) / sin(theta)^2
+    float energy = 0.f;
+    for (int i = activeBegin; i < activeEnd; i++) {
+        float qk = qq[0][i];
+        float qk1 = qq[1][i];
+        energy += (qk*qk - modeA[i]*qk*qk1 + modeB[i]*qk1*qk1) * modeInvSinSq[i];
+    }
+    return energy;
 }
 int RigidBody::closestVertexIndex(const ofVec3f& worldPos) const {
-    ofVec3f r = RInv * (worldPos - x);
-    float minDistSq = numeric_limits<float>::max();
-    int minIndex = -1;
-    for (int i = 0; i < mesh.getNumVertices(); i++) {
-        float distSq = (mesh.getVertex(i) - r).lengthSquared();
-        if (distSq < minDistSq) {
-            minDistSq = distSq;
-            minIndex = i;
+    // the asset's tree is at unit size
+    return asset->vertexTree.nearest(RInv * (worldPos - x) / sizeScale);
+}
+
+void RigidBody::hullVerticesBeyond(const ofVec3f& worldDir, float minExtent, int* hint, vector<int>* indices) {
+    // in the asset's space: dir . p >= minBodyExtent
+    const ConvexHull& hull = asset->hull;
+    ofVec3f dir = RInv * worldDir;
+    float minBodyExtent = (minExtent - worldDir.dot(x)) / sizeScale;
+    int h = hull.support(dir, hint);
+    if (h < 0 || hull.position(h).dot(dir) < minBodyExtent) {
+        return;
+    }
+    // the hull vertices beyond a plane are connected by hull edges, so walking down from the
+    // furthest one finds them all
+    int begin = indices->size();
+    if (hull.isFlat()) {
+        for (int g = 0; g < hull.numVertices(); g++) {
+            if (hull.position(g).dot(dir) >= minBodyExtent) {
+                indices->push_back(hull.vertex(g));
+            }
         }
+        return;
+    }
+    if (hullVisited.size() != hull.numVertices() || ++hullVisitCount == 0) {
+        hullVisited.assign(hull.numVertices(), 0);
+        hullVisitCount = 1;
+    }
+    hullVisited[h] = hullVisitCount;
+    indices->push_back(h);
+    for (int k = begin; k < indices->size(); k++) {
+        int g = (*indices)[k];
+        for (const int* n = hull.neighborsBegin(g); n != hull.neighborsEnd(g); n++) {
+            if (hullVisited[*n] != hullVisitCount) {
+                hullVisited[*n] = hullVisitCount;
+                if (hull.position(*n).dot(dir) >= minBodyExtent) {
+                    indices->push_back(*n);
+                }
+            }
+        }
+    }
+    for (int k = begin; k < indices->size(); k++) {
+        (*indices)[k] = hull.vertex((*indices)[k]);
+    }
+}
+
+void RigidBody::closestVertexIndices(const ofVec3f& worldPos, int k, vector<int>* indices) const {
+    asset->vertexTree.nearest(RInv * (worldPos - x) / sizeScale, k, indices);
+}
+
+void RigidBody::validateVertexCache() {
+    if (vertexCacheCount != 0 && q.x() == vertexCacheQ.x() && q.y() == vertexCacheQ.y() &&
+        q.z() == vertexCacheQ.z() && q.w() == vertexCacheQ.w()) {
+        return;
+    }
+    vertexCacheQ = q;
+    if (vertexCached.size() != numVertices() || ++vertexCacheCount == 0) {
+        vertexCached.assign(numVertices(), 0);
+        vertexOffsets.resize(numVertices());
+        vertexCacheCount = 1;
+    }
+}
+
+// out[indices[k]] = R * (s * p[indices[k]]), the same arithmetic as R * vertex(i)
+static void transformVertices(const ofMatrix3x3& R, float s, const ofVec3f* p, const int* indices, int n,
+                              ofVec3f* out) {
+    int k = 0;
+#ifdef RIGIDBODY_X86
+    const __m128 vs = _mm_set1_ps(s);
+    const float r[9] = { R.a, R.b, R.c, R.d, R.e, R.f, R.g, R.h, R.i };
+    __m128 m[9];
+    for (int e = 0; e < 9; e++) {
+        m[e] = _mm_set1_ps(r[e]);
+    }
+    for (; k + 4 <= n; k += 4) {
+        const ofVec3f& p0 = p[indices[k]];
+        const ofVec3f& p1 = p[indices[k + 1]];
+        const ofVec3f& p2 = p[indices[k + 2]];
+        const ofVec3f& p3 = p[indices[k + 3]];
+        __m128 x = _mm_mul_ps(_mm_set_ps(p3.x, p2.x, p1.x, p0.x), vs);
+        __m128 y = _mm_mul_ps(_mm_set_ps(p3.y, p2.y, p1.y, p0.y), vs);
+        __m128 z = _mm_mul_ps(_mm_set_ps(p3.z, p2.z, p1.z, p0.z), vs);
+        float ox[4], oy[4], oz[4];
+        _mm_storeu_ps(ox, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], x), _mm_mul_ps(m[1], y)), _mm_mul_ps(m[2], z)));
+        _mm_storeu_ps(oy, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[3], x), _mm_mul_ps(m[4], y)), _mm_mul_ps(m[5], z)));
+        _mm_storeu_ps(oz, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[6], x), _mm_mul_ps(m[7], y)), _mm_mul_ps(m[8], z)));
+        for (int j = 0; j < 4; j++) {
+            out[indices[k + j]] = ofVec3f(ox[j], oy[j], oz[j]);
+        }
+    }
+#endif
+    for (; k < n; k++) {
+        out[indices[k]] = R * (p[indices[k]] * s);
+    }
+}
+
+void RigidBody::cacheVertices(const int* indices, int n) {
+    validateVertexCache();
+    vertexCacheMisses.clear();
+    for (int k = 0; k < n; k++) {
+        int i = indices[k];
+        if (vertexCached[i] != vertexCacheCount) {
+            vertexCached[i] = vertexCacheCount;
+            vertexCacheMisses.push_back(i);
+        }
+    }
+    if (!vertexCacheMisses.empty()) {
+        transformVertices(R, sizeScale, &asset->mesh.getVertices()[0], &vertexCacheMisses[0],
+                          vertexCacheMisses.size(), &vertexOffsets[0]);
+    }
+}
+
+const ofVec3f& RigidBody::worldOffset(int i) {
+    validateVertexCache();
+    if (vertexCached[i] != vertexCacheCount) {
+        vertexCached[i] = vertexCacheCount;
+        vertexOffsets[i] = R * vertex(i);
     }
-    return minIndex;
+    return vertexOffsets[i];
 }
 
-ofVec3f RigidBody::getXi(int i) const {
-    return x + R * mesh.getVertex(i);
+ofVec3f RigidBody::getXi(int i) {
+    return x + worldOffset(i);
 }
 
-ofVec3f RigidBody::getVi(int i) const {
-    return v + w.crossed(R * mesh.getVertex(i));
+ofVec3f RigidBody::getVi(int i) {
+    return v + w.crossed(worldOffset(i));
 }
@@ -3,6 +3,8 @@
 
 #include <Eigen/Dense>
 #include "redsvd/redsvd.hpp"
+#include "ModalBank.h"
+#include "ModalAsset.h"
 
 #include "ofMain.h"
 
@@ -17,6 +19,15 @@ struct Material {
     ofColor color;
 };
 
+// Modes outside [minHz, maxHz] or above the Nyquist frequency of sampleRate are never run.
+struct AudibleBand {
+    AudibleBand(float sampleRate = 44100.f, float minHz = 20.f, float maxHz = 20000.f)
+        : sampleRate(sampleRate), minHz(minHz), maxHz(maxHz) {}
+    float sampleRate;
+    float minHz;
+    float maxHz;
+};
+
 struct VertexImpulse {
     VertexImpulse(int vertex, const ofVec3f& impulse)
         : vertex(vertex), impulse(impulse) {}
@@ -24,11 +35,14 @@ struct VertexImpulse {
     ofVec3f impulse;
 };
 
+enum { VOICE_OFF = 0, VOICE_ON, VOICE_FADING };
+
 struct RigidBody {
 public:
     RigidBody(const string& modesFileName, float E, float nu, float rho, float alpha, float beta, 
               const string& objFileName, const Material& material, float sizeScale,
-              bool isSphere = false);
+              bool isSphere = false, const AudibleBand& band = AudibleBand(),
+              const ModeShapeOptions& modeShapes = ModeShapeOptions());
 
     void rotate(float rad, const ofVec3f& axis);
     
@@ -37,25 +51,66 @@ public:
     
     int stepAudio(float dt, const vector<VertexImpulse>& impulses, float dt_q, float* qSum);
 
+    // stepAudio split in two, so the modes of all bodies can be scheduled in between:
+    // prepareAudio wakes the body and projects the impulses onto the modes, and returns the
+    // number of q's to compute; synthesizeAudio runs the voiced modes and adds them to qSum.
+    int prepareAudio(float dt, const vector<VertexImpulse>& impulses, float dt_q);
+    void synthesizeAudio(int qsToCompute, float* qSum);
+
+    // sum of the squared envelope amplitudes of all modes
+    float modalEnergy() const;
+
+    // squared envelope amplitude of mode i including the pending excitation, if any
+    float modeLoudnessSq(int i) const;
+
+    // voices the modes with modeSelected set; voiced modes that are no longer selected are
+    // faded out over the next synthesizeAudio call
+    void applyModeSelection();
+
     int closestVertexIndex(const ofVec3f& worldPos) const;
+    // the k vertices closest to worldPos, closest first
+    void closestVertexIndices(const ofVec3f& worldPos, int k, vector<int>* indices) const;
 
-    ofVec3f getXi(int i) const;
-    ofVec3f getVi(int i) const;
+    // appends the convex hull vertices p with worldDir . p >= minExtent in world space, where
+    // worldDir is a unit vector. *hint is the hull vertex to start the search from (see
+    // supportHints) and is set to the one furthest along worldDir.
+    void hullVerticesBeyond(const ofVec3f& worldDir, float minExtent, int* hint, vector<int>* indices);
+
+    // world-space offset R * vertex(i) of a vertex from the center of mass. Offsets are cached
+    // once computed and stay valid until q changes; cacheVertices computes the listed vertices
+    // that aren't cached yet together, four at a time with SSE, so a caller that is about to
+    // read several should list them first.
+    void cacheVertices(const int* indices, int n);
+    const ofVec3f& worldOffset(int i);
+
+    ofVec3f getXi(int i);
+    ofVec3f getVi(int i);
+
+    // vertices in bodyspace, at this body's size
+    int numVertices() const { return asset->mesh.getNumVertices(); }
+    ofVec3f vertex(int i) const { return asset->mesh.getVertex(i) * sizeScale; }
 
 private:
     void computeMIBodyIBodyInv();
 
-    void readModes(const string& fileName, float E, float nu, float rho, float sizeScale,
-        vector<vector<ofVec3f>>* phi, vector<float>* omega);
+    void validateVertexCache();
+
+    bool modeCoefsStale(float h) const;
+    void updateModeCoefs(float h);
+
+    void selectModes(float E, float nu, float rho, const AudibleBand& band);
 
 public:
-    ofMesh mesh;
+    // mesh and mode shapes, shared with the other bodies made from the same files
+    shared_ptr<const ModalAsset> asset;
     const Material& material;
+    float sizeScale;
 
     // Constant quantities
     float m;
     ofMatrix3x3 IBody;
     ofMatrix3x3 IBodyInv;
+    ofVec3f IPrincipal;     // IBody in the frame of asset->principalAxes, where it's diagonal
 
     // State variables
     ofVec3f x;          // position (center of mass)
@@ -70,14 +125,57 @@ public:
     ofVec3f v;          // linear velocity      v = P / m
     ofVec3f w;          // angular velocity     w = IInv * L
 
-
-    // Modes (Constant)
-    vector<vector<ofVec3f>> phi;    // eigenvectors
+    // hull vertices the support searches along -x, +x, -y, +y, -z, +z last ended at; as the
+    // body turns the next search only walks a step or two from there
+    int supportHints[6];
+    vector<unsigned int> hullVisited;   // the last hullVerticesBeyond call that reached each hull vertex
+    unsigned int hullVisitCount;
+
+    // world-space vertex offsets, see cacheVertices. vertexOffsets[i] is current if
+    // vertexCached[i] == vertexCacheCount; the count moves on whenever q differs from vertexCacheQ.
+    vector<ofVec3f> vertexOffsets;
+    vector<unsigned int> vertexCached;
+    unsigned int vertexCacheCount;
+    ofQuaternion vertexCacheQ;
+    vector<int> vertexCacheMisses;
+
+    // Modes (Constant): this body runs modes [modeBase, modeBase + omega.size()) of the asset
+    int modeBase;
+    float phiScale;                 // scales the asset's eigenvectors to this body
     vector<float> omega;            // natural frequencies
 
-    // Modal amplitudes
-    vector<float> qq[3];        // 3 most recent q vectors: q(k-2),q(k-1),q(k)
-    int qkAt;                   // index where q(k) is stored
+    // Modal amplitudes (padded to a multiple of MODAL_BANK_WIDTH)
+    AlignedFloats qq[2];        // 2 most recent q vectors: qq[0] = q(k), qq[1] = q(k-1)
+
+    // Resonator recurrence coefficients (one entry per mode; 0 for inactive modes)
+    // q(k) = modeA * q(k-1) - modeB * q(k-2) + modeGain * (phi . F)
+    AlignedFloats modeA;        // 2 * e * cos(theta)
+    AlignedFloats modeB;        // e^2
+    AlignedFloats modeGain;     // excitation gain of a force held over the first time-step
+    AlignedFloats modeForces;   // modeGain * (phi . F) of the current impulses, per mode
+    AlignedFloats assetForces;  // unscaled projections onto the asset's 16-bit mode shapes
+    Eigen::VectorXf reducedForces;  // phiU^T . F of the current impulses, for low-rank modes
+    AlignedFloats modeInvSinSq; // 1 / sin(theta)^2, to get a mode's envelope from its last 2 q's
+    AlignedFloats modeAudibility;   // perceptual weight of each mode's frequency
+    int activeBegin;            // modes outside [activeBegin, activeEnd) are inactive;
+    int activeEnd;              // activeBegin is a multiple of MODAL_BANK_WIDTH
+    bool pendingExcitation;     // modeForces holds impulses not yet synthesized
+
+    // Voices: which modes are synthesized. Every active mode is voiced unless a ModeScheduler
+    // says otherwise. The voiced modes are gathered into dense arrays before synthesis so the
+    // cost is proportional to the number of voiced modes.
+    vector<unsigned char> modeVoice;    // VOICE_OFF, VOICE_ON or VOICE_FADING
+    vector<unsigned char> modeSelected; // filled in by ModeScheduler
+    vector<int> voiceModes;
+    AlignedFloats voiceA, voiceB, voiceU, voiceQ1, voiceQ2;
+
+    // values the coefficient table was built with
+    float coefH;
+    float coefAlpha;
+    float coefBeta;
+    bool coefTopModes;
+    int coefNModesOnly;
+    int coefModesLoaded;
 
     // Damping parameters
     const float alpha;
@@ -87,6 +185,18 @@ public:
     const bool isSphere;
     float r;
 
+    // Sleeping bodies: a body that has been at rest for a while is left out of collisions and
+    // integration until it is woken (see ofApp::update)
+    bool asleep;
+    float stillTime;        // how long the body has moved slower than the sleep speed
+
+    // Sleeping resonators: once the modal energy drops below audioSleepThreshold^2 the
+    // resonator bank stops running (and costs nothing) until the next impulse wakes it.
+    float audioSleepThreshold;  // in units of q
+    bool audioAsleep;
+    int audioSleepCount;
+    int audioWakeCount;
+
     bool topModes;  // FOR TUNING DAMPING PARAMS
     int nModesOnly;
 
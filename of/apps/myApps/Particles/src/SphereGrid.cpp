@@ -0,0 +1,192 @@
+#include "SphereGrid.h"
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+SphereGrid::SphereGrid()
+    : cellSize(1.f), seenCount(0) {
+}
+
+void SphereGrid::clear(int numSpheres) {
+    boxes.resize(numSpheres);
+    asleep.assign(numSpheres, 0);
+    neighborLists.resize(numSpheres);
+}
+
+void SphereGrid::setSweep(int i, const ofVec3f& x, const ofVec3f& v, float r, float t) {
+    ofVec3f end = x + t * v;
+    Box& box = boxes[i];
+    for (int c = 0; c < 3; c++) {
+        box.lo[c] = min(x[c], end[c]) - r;
+        box.hi[c] = max(x[c], end[c]) + r;
+    }
+}
+
+void SphereGrid::build() {
+    // cells about twice the size of an average box: most boxes cover one to eight cells, and a
+    // cell holds a few boxes
+    float sideSum = 0.f;
+    for (int i = 0; i < boxes.size(); i++) {
+        ofVec3f side = boxes[i].hi - boxes[i].lo;
+        sideSum += max(side.x, max(side.y, side.z));
+    }
+    cellSize = boxes.empty() ? 1.f : 2.f * sideSum / boxes.size();
+    if (!(cellSize > 0.f)) {
+        cellSize = 1.f;
+    }
+
+    // about two buckets per sphere; the buckets keep their memory from frame to frame
+    int numBuckets = 64;
+    while (numBuckets < 2 * boxes.size()) {
+        numBuckets *= 2;
+    }
+    if (buckets.size() != numBuckets) {
+        buckets.clear();
+        buckets.resize(numBuckets);
+    } else {
+        for (int b = 0; b < numBuckets; b++) {
+            buckets[b].clear();
+        }
+    }
+    large.clear();
+    for (int i = 0; i < boxes.size(); i++) {
+        insert(i);
+    }
+    // two sleeping spheres can't meet, so only the awake ones look for neighbors; a sleeping
+    // sphere is told about the awake ones that find it
+    for (int i = 0; i < boxes.size(); i++) {
+        if (asleep[i]) {
+            neighborLists[i].clear();
+        } else {
+            findNeighbors(i);
+        }
+    }
+    for (int i = 0; i < boxes.size(); i++) {
+        if (!asleep[i]) {
+            const vector<int>& found = neighborLists[i];
+            for (int k = 0; k < found.size(); k++) {
+                if (asleep[found[k]]) {
+                    neighborLists[found[k]].push_back(i);
+                }
+            }
+        }
+    }
+}
+
+void SphereGrid::update(int i, const ofVec3f& x, const ofVec3f& v, float r, float t) {
+    for (int k = 0; k < neighborLists[i].size(); k++) {
+        vector<int>& other = neighborLists[neighborLists[i][k]];
+        vector<int>::iterator it = find(other.begin(), other.end(), i);
+        *it = other.back();
+        other.pop_back();
+    }
+    remove(i);
+    asleep[i] = 0;
+    setSweep(i, x, v, r, t);
+    insert(i);
+    findNeighbors(i);
+    for (int k = 0; k < neighborLists[i].size(); k++) {
+        neighborLists[neighborLists[i][k]].push_back(i);
+    }
+}
+
+void SphereGrid::cellRange(const Box& box, int lo[3], int hi[3]) const {
+    // clamped so a runaway sphere can't overflow the cell coordinates; it just lands off the grid
+    const float limit = 1e6f;
+    for (int c = 0; c < 3; c++) {
+        lo[c] = (int)floorf(min(max(box.lo[c] / cellSize, -limit), limit));
+        hi[c] = (int)floorf(min(max(box.hi[c] / cellSize, -limit), limit));
+    }
+}
+
+int SphereGrid::bucket(int ix, int iy, int iz) const {
+    // the spatial hash of Teschner et al. 2003
+    unsigned int h = ((unsigned int)ix * 73856093u) ^ ((unsigned int)iy * 19349663u) ^ ((unsigned int)iz * 83492791u);
+    return (int)(h & (unsigned int)(buckets.size() - 1));
+}
+
+bool SphereGrid::isLarge(int i) const {
+    int lo[3], hi[3];
+    cellRange(boxes[i], lo, hi);
+    long long numCells = (long long)(hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) * (hi[2] - lo[2] + 1);
+    return numCells > MAX_BOX_CELLS;
+}
+
+void SphereGrid::insert(int i) {
+    if (isLarge(i)) {
+        large.push_back(i);
+        return;
+    }
+    int lo[3], hi[3];
+    cellRange(boxes[i], lo, hi);
+    for (int ix = lo[0]; ix <= hi[0]; ix++) {
+        for (int iy = lo[1]; iy <= hi[1]; iy++) {
+            for (int iz = lo[2]; iz <= hi[2]; iz++) {
+                buckets[bucket(ix, iy, iz)].push_back(i);
+            }
+        }
+    }
+}
+
+void SphereGrid::remove(int i) {
+    if (isLarge(i)) {
+        large.erase(find(large.begin(), large.end(), i));
+        return;
+    }
+    int lo[3], hi[3];
+    cellRange(boxes[i], lo, hi);
+    for (int ix = lo[0]; ix <= hi[0]; ix++) {
+        for (int iy = lo[1]; iy <= hi[1]; iy++) {
+            for (int iz = lo[2]; iz <= hi[2]; iz++) {
+                vector<int>& cell = buckets[bucket(ix, iy, iz)];
+                vector<int>::iterator it = find(cell.begin(), cell.end(), i);
+                *it = cell.back();
+                cell.pop_back();
+            }
+        }
+    }
+}
+
+void SphereGrid::findNeighbors(int i) {
+    vector<int>& found = neighborLists[i];
+    found.clear();
+    if (isLarge(i)) {
+        for (int j = 0; j < boxes.size(); j++) {
+            if (j != i && boxes[i].overlaps(boxes[j])) {
+                found.push_back(j);
+            }
+        }
+        return;
+    }
+
+    if (seen.size() != boxes.size() || ++seenCount == 0) {
+        seen.assign(boxes.size(), 0);
+        seenCount = 1;
+    }
+    seen[i] = seenCount;
+    int lo[3], hi[3];
+    cellRange(boxes[i], lo, hi);
+    for (int ix = lo[0]; ix <= hi[0]; ix++) {
+        for (int iy = lo[1]; iy <= hi[1]; iy++) {
+            for (int iz = lo[2]; iz <= hi[2]; iz++) {
+                const vector<int>& cell = buckets[bucket(ix, iy, iz)];
+                for (int k = 0; k < cell.size(); k++) {
+                    int j = cell[k];
+                    if (seen[j] != seenCount) {
+                        seen[j] = seenCount;
+                        if (boxes[i].overlaps(boxes[j])) {
+                            found.push_back(j);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    for (int k = 0; k < large.size(); k++) {
+        int j = large[k];
+        if (j != i && boxes[i].overlaps(boxes[j])) {
+            found.push_back(j);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef SPHEREGRID_H
+#define SPHEREGRID_H
+
+#include <vector>
+
+#include "ofMain.h"
+
+// Broadphase for sphere-sphere collisions: each sphere is given the box it sweeps through over
+// the rest of the frame, the boxes are binned into a uniform grid, and only spheres whose boxes
+// overlap are neighbors. Two spheres that aren't neighbors can't collide before the end of the
+// frame. The grid cells are hashed into a fixed number of buckets, so the scene bounds don't
+// matter; cells that share a bucket only add candidates, which the box test throws out.
+class SphereGrid {
+public:
+    SphereGrid();
+
+    // starts a new frame with numSpheres spheres; every sphere then needs setSweep before build
+    void clear(int numSpheres);
+    // sphere i moves from x with velocity v for time t
+    void setSweep(int i, const ofVec3f& x, const ofVec3f& v, float r, float t);
+    // sphere i is asleep this frame: it holds still, and it only has to be found by the spheres
+    // that are awake. its neighbor list holds just the awake spheres overlapping it.
+    void setAsleep(int i) { asleep[i] = 1; }
+    // bins the boxes and finds everyone's neighbors; the cells are about twice the average box
+    void build();
+
+    // sphere i's velocity changed: it is swept again from x over the t left, and its neighbors
+    // are found again. the other boxes still cover their spheres, so nothing else is touched.
+    // a sleeping sphere that wakes is updated the same way, and is awake from then on.
+    void update(int i, const ofVec3f& x, const ofVec3f& v, float r, float t);
+
+    // spheres whose boxes overlap sphere i's, in no particular order
+    const std::vector<int>& neighbors(int i) const { return neighborLists[i]; }
+
+private:
+    struct Box {
+        ofVec3f lo, hi;
+        bool overlaps(const Box& other) const {
+            return lo.x <= other.hi.x && other.lo.x <= hi.x &&
+                   lo.y <= other.hi.y && other.lo.y <= hi.y &&
+                   lo.z <= other.hi.z && other.lo.z <= hi.z;
+        }
+    };
+
+    // a box covering more cells than this is kept off the grid and checked against everyone
+    static const int MAX_BOX_CELLS = 64;
+
+    void cellRange(const Box& box, int lo[3], int hi[3]) const;
+    int bucket(int ix, int iy, int iz) const;
+    bool isLarge(int i) const;
+    void insert(int i);
+    void remove(int i);
+    void findNeighbors(int i);      // fills neighborLists[i] only
+
+    std::vector<Box> boxes;
+    std::vector<unsigned char> asleep;
+    std::vector<std::vector<int>> neighborLists;
+    float cellSize;
+    std::vector<std::vector<int>> buckets;  // a power of two of them, kept between frames
+    std::vector<int> large;         // spheres whose boxes are off the grid
+    std::vector<unsigned int> seen; // stamps to skip a sphere met in several cells
+    unsigned int seenCount;
+};
+
+#endif
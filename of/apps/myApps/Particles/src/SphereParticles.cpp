@@ -0,0 +1,172 @@
+#include "SphereParticles.h"
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+int SphereParticles::add(const ofVec3f& position, const ofVec3f& velocity, float radius, float mass) {
+    x.push_back(position.x);
+    y.push_back(position.y);
+    z.push_back(position.z);
+    vx.push_back(velocity.x);
+    vy.push_back(velocity.y);
+    vz.push_back(velocity.z);
+    r.push_back(radius);
+    invMass.push_back(1.f / mass);
+    t.push_back(0.f);
+    asleep.push_back(0);
+    stillTime.push_back(0.f);
+    nextInIsland.push_back(size() - 1);
+    return size() - 1;
+}
+
+void SphereParticles::accelerate(const ofVec3f& a, float dt) {
+    const int n = size();
+    const float ax = a.x * dt, ay = a.y * dt, az = a.z * dt;
+    for (int i = 0; i < n; i++) {
+        if (asleep[i]) {
+            continue;
+        }
+        vx[i] += ax;
+        vy[i] += ay;
+        vz[i] += az;
+    }
+}
+
+void SphereParticles::attract(const ofVec3f& p, float strength, float dt) {
+    const int n = size();
+    for (int i = 0; i < n; i++) {
+        if (asleep[i]) {
+            continue;
+        }
+        float dx = p.x - x[i], dy = p.y - y[i], dz = p.z - z[i];
+        float dist = sqrtf(dx * dx + dy * dy + dz * dz);
+        if (dist >= 0.01f) {
+            float s = strength / (dist * dist) * dt;
+            vx[i] += s * dx;
+            vy[i] += s * dy;
+            vz[i] += s * dz;
+        }
+    }
+}
+
+void SphereParticles::advance(int i, float time) {
+    float dt = time - t[i];
+    if (dt > 0.f) {
+        x[i] += dt * vx[i];
+        y[i] += dt * vy[i];
+        z[i] += dt * vz[i];
+        t[i] = time;
+    }
+}
+
+int SphereParticles::findIsland(int i) {
+    while (islandParent[i] != i) {
+        islandParent[i] = islandParent[islandParent[i]];
+        i = islandParent[i];
+    }
+    return i;
+}
+
+enum { ISLAND_AWAKE = 1, ISLAND_RESTLESS = 2 };
+
+int SphereParticles::sleepIslands(const SphereGrid& grid, float sleepSpeed, float sleepTime, float dt) {
+    const int n = size();
+    // particles closer than this many times the sum of their radii are touching
+    const float reach = 1.1f;
+
+    // join the particles into islands: the sleeping ones are joined through their rings, and
+    // each awake particle to the particles it touches
+    islandParent.resize(n);
+    for (int i = 0; i < n; i++) {
+        islandParent[i] = i;
+    }
+    for (int i = 0; i < n; i++) {
+        int a = findIsland(i);
+        int b = findIsland(asleep[i] ? nextInIsland[i] : i);
+        if (a != b) {
+            islandParent[max(a, b)] = min(a, b);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        if (asleep[i]) {
+            continue;
+        }
+        if (vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i] < sleepSpeed * sleepSpeed) {
+            stillTime[i] += dt;
+        } else {
+            stillTime[i] = 0.f;
+        }
+        const vector<int>& neighbors = grid.neighbors(i);
+        for (int k = 0; k < neighbors.size(); k++) {
+            int j = neighbors[k];
+            float dx = x[i] - x[j], dy = y[i] - y[j], dz = z[i] - z[j];
+            float rSum = reach * (r[i] + r[j]);
+            if (dx * dx + dy * dy + dz * dz < rSum * rSum) {
+                int a = findIsland(i);
+                int b = findIsland(j);
+                if (a != b) {
+                    islandParent[max(a, b)] = min(a, b);
+                }
+            }
+        }
+    }
+
+    // an island with awake particles sleeps once none of them is restless
+    islandState.assign(n, 0);
+    for (int i = 0; i < n; i++) {
+        if (!asleep[i]) {
+            int a = findIsland(i);
+            islandState[a] |= ISLAND_AWAKE;
+            if (stillTime[i] < sleepTime) {
+                islandState[a] |= ISLAND_RESTLESS;
+            }
+        }
+    }
+
+    // link each island going to sleep into a ring
+    islandFirst.assign(n, -1);
+    islandLast.assign(n, -1);
+    int numSlept = 0;
+    for (int i = 0; i < n; i++) {
+        int a = findIsland(i);
+        if (islandState[a] != ISLAND_AWAKE) {
+            continue;
+        }
+        if (islandFirst[a] < 0) {
+            islandFirst[a] = i;
+        } else {
+            nextInIsland[islandLast[a]] = i;
+        }
+        islandLast[a] = i;
+        if (!asleep[i]) {
+            asleep[i] = 1;
+            vx[i] = vy[i] = vz[i] = 0.f;
+            numSlept++;
+        }
+    }
+    for (int a = 0; a < n; a++) {
+        if (islandFirst[a] >= 0) {
+            nextInIsland[islandLast[a]] = islandFirst[a];
+        }
+    }
+    return numSlept;
+}
+
+void SphereParticles::wake(int i, vector<int>* woken) {
+    if (!asleep[i]) {
+        return;
+    }
+    int k = i;
+    do {
+        asleep[k] = 0;
+        stillTime[k] = 0.f;
+        woken->push_back(k);
+        k = nextInIsland[k];
+    } while (k != i);
+}
+
+void SphereParticles::wakeAll() {
+    asleep.assign(size(), 0);
+    stillTime.assign(size(), 0.f);
+}
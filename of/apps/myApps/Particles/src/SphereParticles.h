@@ -0,0 +1,67 @@
+#ifndef SPHEREPARTICLES_H
+#define SPHEREPARTICLES_H
+
+#include <vector>
+
+#include "ofMain.h"
+#include "SphereGrid.h"
+
+// The translational state of the spheres, one array per component, for the sphere collision
+// loop: it only needs positions, velocities, radii and masses, and walks them far more often
+// than anything else. Particle i is drawn and heard through sphereBodies[i], which all share the
+// sphere's ModalAsset; the bodies are brought up to date from here when their particles change.
+// A frictionless sphere never gains spin, so rotation isn't tracked.
+struct SphereParticles {
+    SphereParticles() {}
+
+    int size() const { return (int)x.size(); }
+
+    // returns the new particle's index
+    int add(const ofVec3f& position, const ofVec3f& velocity, float radius, float mass);
+
+    ofVec3f position(int i) const { return ofVec3f(x[i], y[i], z[i]); }
+    ofVec3f velocity(int i) const { return ofVec3f(vx[i], vy[i], vz[i]); }
+    void setVelocity(int i, const ofVec3f& v) { vx[i] = v.x; vy[i] = v.y; vz[i] = v.z; }
+    // where particle i is at time t of the frame, without moving it there
+    ofVec3f positionAt(int i, float time) const { return position(i) + (time - t[i]) * velocity(i); }
+
+    // v += a * dt for every awake particle
+    void accelerate(const ofVec3f& a, float dt);
+    // pulls every awake particle towards p with an acceleration of strength / distance
+    void attract(const ofVec3f& p, float strength, float dt);
+
+    // every particle is at the start of the frame
+    void startFrame() { t.assign(x.size(), 0.f); }
+    // moves particle i along its velocity to time t of the frame, if it isn't there already
+    void advance(int i, float time);
+
+    // Sleeping: the particles touching each other at the end of a frame form an island, and
+    // once every particle of an island has been slower than sleepSpeed for sleepTime, the
+    // island is put to sleep. Its particles stop and are skipped until something wakes them;
+    // they are linked in a ring through nextInIsland so they wake together.
+    // counts the time the awake particles have been slow and puts the islands that have all been
+    // slow long enough to sleep; grid has this frame's neighbors. returns the number put to sleep.
+    int sleepIslands(const SphereGrid& grid, float sleepSpeed, float sleepTime, float dt);
+    // wakes particle i's island and appends the particles woken to *woken
+    void wake(int i, std::vector<int>* woken);
+    void wakeAll();
+
+    std::vector<float> x, y, z;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> r;
+    std::vector<float> invMass;
+    std::vector<float> t;           // how far into the frame each particle has been moved
+
+    std::vector<unsigned char> asleep;
+    std::vector<float> stillTime;   // how long each awake particle has been slower than the sleep speed
+    std::vector<int> nextInIsland;  // the next particle of a sleeping particle's island
+
+private:
+    int findIsland(int i);
+
+    std::vector<int> islandParent;  // union-find forest of sleepIslands
+    std::vector<int> islandFirst, islandLast;
+    std::vector<unsigned char> islandState;
+};
+
+#endif
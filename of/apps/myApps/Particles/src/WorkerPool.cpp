@@ -0,0 +1,91 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int numWorkers)
+    :
+    quit(false),
+    generation(0),
+    workersBusy(0),
+    fn(NULL),
+    n(0)
+{
+    next = 0;
+    if (numWorkers < 0) {
+        numWorkers = (int)std::thread::hardware_concurrency() - 1;
+    }
+    for (int i = 0; i < numWorkers; i++) {
+        workers.push_back(std::thread(&WorkerPool::workerLoop, this));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        quit = true;
+    }
+    workReady.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::runIterations() {
+    while (true) {
+        int i = next++;
+        if (i >= n) {
+            break;
+        }
+        (*fn)(i);
+    }
+}
+
+void WorkerPool::workerLoop() {
+    unsigned int generationSeen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            while (!quit && generation == generationSeen) {
+                workReady.wait(guard);
+            }
+            if (quit) {
+                return;
+            }
+            generationSeen = generation;
+        }
+
+        runIterations();
+
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            workersBusy--;
+        }
+        workDone.notify_one();
+    }
+}
+
+void WorkerPool::parallelFor(int n, const std::function<void(int)>& fn) {
+    if (workers.empty() || n <= 1) {
+        for (int i = 0; i < n; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        this->fn = &fn;
+        this->n = n;
+        next = 0;
+        workersBusy = (int)workers.size();
+        generation++;
+    }
+    workReady.notify_all();
+
+    runIterations();
+
+    // every worker must have picked up this generation before fn goes out of scope
+    std::unique_lock<std::mutex> guard(lock);
+    while (workersBusy > 0) {
+        workDone.wait(guard);
+    }
+    this->fn = NULL;
+}
@@ -0,0 +1,46 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// A fixed set of worker threads that run the iterations of a loop in parallel.
+// The calling thread also takes iterations, so a pool with 0 workers runs everything inline.
+class WorkerPool {
+public:
+    // numWorkers < 0 uses one worker per hardware thread besides the caller
+    explicit WorkerPool(int numWorkers = -1);
+    ~WorkerPool();
+
+    int numWorkers() const { return (int)workers.size(); }
+
+    // calls fn(i) for every i in [0, n) and returns once all calls have finished.
+    // iterations are handed out dynamically, so fn must not depend on which thread runs it.
+    void parallelFor(int n, const std::function<void(int)>& fn);
+
+private:
+    WorkerPool(const WorkerPool&);
+    WorkerPool& operator=(const WorkerPool&);
+
+    void workerLoop();
+    void runIterations();
+
+    std::vector<std::thread> workers;
+
+    std::mutex lock;
+    std::condition_variable workReady;
+    std::condition_variable workDone;
+    bool quit;
+    unsigned int generation;            // incremented for every parallelFor call
+    int workersBusy;
+
+    const std::function<void(int)>* fn;
+    int n;
+    std::atomic<int> next;              // next iteration to hand out
+};
+
+#endif
@@ -12,6 +12,20 @@ static const Material materials[NUM_MATERIALS] = { STEEL_MATERIAL, CERAMIC_MATER
 
 static const Material wallMaterial = STEEL_MATERIAL;
 
+static const AudibleBand audibleBand = AudibleBand(AUDIO_SAMPLE_RATE, 20.f, 20000.f);
+// 16-bit mode shapes halve the mode memory; int16 projects faster than half floats on CPUs
+// without F16C
+static const ModeShapeStorage modeShapeStorage = MODE_SHAPES_INT16;
+
+// most sequential-impulse passes over a body's wall contacts per frame
+static const int CONTACT_ITERATIONS = 16;
+
+// a body (or an island of touching spheres) slower than SLEEP_SPEED in m/s for SLEEP_TIME
+// seconds is put to sleep; for a mesh body the speed of its rim from spinning counts too.
+// resting spheres still bounce at about gravity * dt each frame, well under SLEEP_SPEED.
+static const float SLEEP_SPEED = 0.05f;
+static const float SLEEP_TIME = 0.5f;
+
 
 static const string sphereObjFileName = "C:/Users/wangyix/Desktop/GitHub/CS448Z/of/apps/myApps/Particles/models/sphere/sphere.obj";
 static const string rodObjFileName = "C:/Users/wangyix/Desktop/GitHub/CS448Z/of/apps/myApps/Particles/models/rod/rod.obj";
@@ -33,11 +47,14 @@ static const int AUDIO_SAMPLES_PAD = SECONDS_TO_SAMPLES(AUDIO_BUFFER_PAD_TIME);
 void ofApp::setup(){
     windowResized(ofGetWidth(), ofGetHeight());
 
+    cout << "Resonator bank kernel: " << resonatorBankKernelName() << endl;
+    cout << "Body integrator kernel: " << BodyIntegrator::kernelName() << endl;
+
     // initialize rigid bodies
-    bodies.push_back(RigidBody(groundModesFileName, 2e11f, 0.4f, 1.f, 30.f, 1e-11f, groundObjFileName, PLASTIC_MATERIAL, 0.008f));
+    bodies.push_back(RigidBody(groundModesFileName, 2e11f, 0.4f, 1.f, 30.f, 1e-11f, groundObjFileName, PLASTIC_MATERIAL, 0.008f, false, audibleBand, modeShapeStorage));
     //bodies.push_back(RigidBody(rodModesFileName, 7e10f, 0.3f, 1.f, 50.f, 1e-11f, rodObjFileName, PLASTIC_MATERIAL, 1.f));
-    sphereBodies.push_back(RigidBody(sphereModesFileName, 7e10f, 0.3f, 1.f, 30.f, 1e-11f, sphereObjFileName, PLASTIC_MATERIAL, 0.04f, true));
-    sphereBodies.push_back(RigidBody(sphereModesFileName, 7e10f, 0.3f, 1.f, 30.f, 1e-11f, sphereObjFileName, PLASTIC_MATERIAL, 0.06f, true));
+    sphereBodies.push_back(RigidBody(sphereModesFileName, 7e10f, 0.3f, 1.f, 30.f, 1e-11f, sphereObjFileName, PLASTIC_MATERIAL, 0.04f, true, audibleBand, modeShapeStorage));
+    sphereBodies.push_back(RigidBody(sphereModesFileName, 7e10f, 0.3f, 1.f, 30.f, 1e-11f, sphereObjFileName, PLASTIC_MATERIAL, 0.06f, true, audibleBand, modeShapeStorage));
     //sphereBodies.push_back(RigidBody(sphereModesFileName, 7e10f, 0.3f, 1.f, 30.f, 1e-11f, sphereObjFileName, PLASTIC_MATERIAL, 0.09f, true));
 
     bodies[0].x = 0.5f * pMin + 0.5f * pMax;
@@ -60,6 +77,7 @@ void ofApp::setup(){
     }
     for (RigidBody& sphereBody : sphereBodies) {
         allBodies.push_back(&sphereBody);
+        spheres.add(sphereBody.x, sphereBody.v, sphereBody.r, sphereBody.m);
     }
 
     // initialize light
@@ -79,6 +97,12 @@ void ofApp::setup(){
 
     qScale = 200.f;
     accelAudioScale = 0.08f;
+
+    parallelAudio = (audioWorkers.numWorkers() > 0);
+    printf("modal synthesis on %d worker threads: %s\n", audioWorkers.numWorkers(), parallelAudio ? "on" : "off");
+
+    firstFrameLogged = false;
+    allModesLoadedLogged = false;
 }
 
 //--------------------------------------------------------------
@@ -269,12 +293,29 @@ static ofVec3f wallIdToNormal(int wallId) {
 
 //--------------------------------------------------------------
 void ofApp::update() {
+    if (!firstFrameLogged) {
+        printf("first frame %llu ms after start\n", ofGetElapsedTimeMillis());
+        firstFrameLogged = true;
+    }
+    if (!allModesLoadedLogged) {
+        bool allModesLoaded = true;
+        for (RigidBody* bodyPtr : allBodies) {
+            allModesLoaded = allModesLoaded && bodyPtr->asset->numModesLoaded() == bodyPtr->asset->numModes();
+        }
+        if (allModesLoaded) {
+            printf("all modes loaded %llu ms after start\n", ofGetElapsedTimeMillis());
+            allModesLoadedLogged = true;
+        }
+    }
+
     float dt = min(0.01, ofGetLastFrameTime());
     if (dt <= 0.f) return;
 
     // apply non-rotational forces to bodies
-    for (RigidBody* bodyPtr : allBodies) {
-        RigidBody& body = *bodyPtr;
+    for (RigidBody& body : bodies) {
+        if (body.asleep) {
+            continue;
+        }
         body.v += gravity * dt;
         if (attract) {
             ofVec3f toAttractPos = attractPos - body.x;
@@ -286,73 +327,95 @@ void ofApp::update() {
         }
         body.P = body.m * body.v;
     }
+    spheres.accelerate(gravity, dt);
+    if (attract) {
+        spheres.attract(attractPos, MOUSE_CURSOR_MASS, dt);
+    }
 
     const float e = 0.5f;   // coefficient of restitution
 
+    unsigned long long audioMicros = 0;     // time spent computing audio this frame
+
     float qSums[AUDIO_SAMPLE_RATE];    // 1 second worth
     memset(qSums, 0, AUDIO_SAMPLE_RATE*sizeof(float));
     int qsComputed = 0;
 
-    // compute collisions of vertices against walls
-    for (RigidBody& body : bodies) {
+    // compute collisions of vertices against walls: every vertex that could reach a wall this
+    // frame is a contact, and the contacts of a body are resolved together
+    vector<vector<VertexImpulse>> bodyImpulses(bodies.size());  // keeps track of impulse(s) applied to each body
+    vector<int> candidates;
+    vector<Contact> contacts;
+    for (int b = 0; b < bodies.size(); b++) {
+        RigidBody& body = bodies[b];
+        if (body.asleep) {
+            continue;
+        }
 
-        vector<VertexImpulse> impulses;
-
-        int i_c = -1;                           // index of the vertex that collides
-        ofVec3f ri_c(0.f, 0.f, 0.f);            // world ri of the vertex that collides
-        ofVec3f xi_c(0.f, 0.f, 0.f);            // world position of vertex that collides
-        ofVec3f vi_c(0.f, 0.f, 0.f);            // world velocity of vertex that collides
-        while (true) {
-            // find vertex with earliest wall collision, if any
-            float dt_c = dt;  // collision will occur dt_c from now
-            int wallId = NONE;
-            for (int i = 0; i < body.mesh.getNumVertices(); i++) {
-                ofVec3f ri = body.R * body.mesh.getVertex(i);
-                ofVec3f xi = body.x + ri;
+        // a vertex can only reach a wall this frame if it's within the furthest any vertex
+        // moves towards the wall in dt of it; those are found by walking the convex hull
+        // down from the vertex furthest towards the wall, so usually few are looked at
+        contacts.clear();
+        float spin = body.w.length() * body.sizeScale * body.asset->radius;
+        for (int k = 0; k < 6; k++) {
+            ofVec3f n = wallIdToNormal(XMIN - k);
+            ofVec3f towardsWall = -n;
+            float maxSpeed = towardsWall.dot(body.v) + spin;
+            if (maxSpeed <= 0.f) {
+                continue;
+            }
+            const ofVec3f& onWall = (k % 2 == 0) ? pMin : pMax;
+            float wallExtent = towardsWall.dot(onWall);
+            candidates.clear();
+            body.hullVerticesBeyond(towardsWall, wallExtent - maxSpeed * dt, &body.supportHints[k], &candidates);
+            if (candidates.empty()) {
+                continue;
+            }
+            body.cacheVertices(&candidates[0], candidates.size());
+            for (int c = 0; c < candidates.size(); c++) {
+                int i = candidates[c];
+                const ofVec3f& ri = body.worldOffset(i);
                 ofVec3f vi = body.v + (body.w.crossed(ri));
-                float t;
-                int id = particleCollideWall(xi, vi, -100000000.f, &dt_c);
-                if (id != NONE) {
-                    wallId = id;
-                    i_c = i;
-                    ri_c = ri;
-                    xi_c = xi;
-                    vi_c = vi;
+                float speed = towardsWall.dot(vi);
+                float gap = wallExtent - towardsWall.dot(body.x + ri);
+                if (speed > 0.f && speed * dt > gap) {
+                    // hits the wall this frame: bounces off
+                    contacts.emplace_back(i, ri, n, e * speed);
+                } else {
+                    // doesn't, but impulses at other vertices could change that; it may close
+                    // the gap but not go past the wall
+                    contacts.emplace_back(i, ri, n, -max(gap, 0.f) / dt);
                 }
             }
+        }
 
-            // compute impulse imparted by collision at this vertex, if any,
-            // and accumulate effect of impulse into P, L
-            if (wallId != NONE) {
-                ofVec3f n = wallIdToNormal(wallId);
-
-                float j = -(1.f + e)*(vi_c.dot(n)) /
-                    (1.f / body.m + ((body.IInv * (ri_c.crossed(n))).crossed(ri_c)).dot(n));
-
-                ofVec3f impulse = j*n;
-
-                // update linear, angular momentum with impulse
-                body.P += impulse;
-                body.L += (ri_c.crossed(impulse));
-                // update linear, angular velocities from momentum
-                body.v = (body.P / body.m);
-                body.w = (body.IInv * body.L);
+        solveContacts(body, contacts, CONTACT_ITERATIONS, &bodyImpulses[b]);
+    }
 
-                impulses.emplace_back(i_c, impulse);
+    // the contacts only change velocities, so all the bodies can then be stepped together
+    vector<RigidBody*> stepped;
+    for (int b = 0; b < bodies.size(); b++) {
+        if (!bodies[b].asleep) {
+            stepped.push_back(&bodies[b]);
+        }
+    }
+    if (!stepped.empty()) {
+        bodyIntegrator.integrate(&stepped[0], stepped.size(), dt);
+    }
 
+    // a mesh body only touches the walls, so it's an island of its own
+    if (!attract) {
+        for (int k = 0; k < stepped.size(); k++) {
+            RigidBody& body = *stepped[k];
+            float spin = body.w.length() * body.sizeScale * body.asset->radius;
+            if (body.v.length() < SLEEP_SPEED && spin < SLEEP_SPEED) {
+                body.stillTime += dt;
             } else {
-                // no collision
-                break;
+                body.stillTime = 0.f;
+            }
+            if (body.stillTime >= SLEEP_TIME) {
+                body.asleep = true;
+                body.v = body.w = body.P = body.L = ofVec3f(0.f, 0.f, 0.f);
             }
-        }
-
-        body.step(dt);
-        body.stepW(dt);
-
-        // compute modal noise amplitudes
-        int qsComputedThisBody = body.stepAudio(dt, impulses, 1.f / AUDIO_SAMPLE_RATE, qSums);
-        if (qsComputedThisBody > qsComputed) {
-            qsComputed = qsComputedThisBody;
         }
     }
 
@@ -363,45 +426,92 @@ void ofApp::update() {
     int accelAudioStart = SECONDS_TO_SAMPLES(0.5);
     int accelAudioEnd = 0;
 
-    const int numSpheres = sphereBodies.size();
+    const int numSpheres = spheres.size();
     vector<vector<VertexImpulse>> sphereImpulses(numSpheres);   // keeps track of impulse(s) applied to each sphereBody
 
-    float dtProcessed = 0.f;
-    while (true) {
-        // find next collision
-        int i_c = -1;       // index of sphere that collides
-        int j_c = -1;       // index of other sphere that collides, or wall id that collides
-        float dt_c = dt - dtProcessed;
-        for (int i = 0; i < numSpheres; i++) {
-            RigidBody& sphere1 = sphereBodies[i];
-            // collide with other spheres
-            for (int j = i + 1; j < numSpheres; j++) {
-                RigidBody& sphere2 = sphereBodies[j];
-                if (spheresCollide(sphere1.x, sphere1.v, sphere1.r, sphere2.x, sphere2.v, sphere2.r, 0.f, &dt_c)) {
-                    i_c = i;
-                    j_c = j;
-                }
+    // the sphere bodies follow their particles; they are only needed to draw and to sound
+    auto syncSphereBody = [&](int i) {
+        RigidBody& body = sphereBodies[i];
+        body.x = spheres.position(i);
+        body.v = spheres.velocity(i);
+        body.P = body.m * body.v;
+    };
+
+    // only spheres whose paths over the frame pass near each other can collide
+    sphereGrid.clear(numSpheres);
+    for (int i = 0; i < numSpheres; i++) {
+        sphereGrid.setSweep(i, spheres.position(i), spheres.velocity(i), spheres.r[i], dt);
+        if (spheres.asleep[i]) {
+            sphereGrid.setAsleep(i);
+        }
+    }
+    sphereGrid.build();
+
+    // Each sphere is only moved when it is hit, and at the end of the frame (spheres.t). In
+    // between it moves in a straight line, so where it is at a later time is known without
+    // moving it.
+    spheres.startFrame();
+
+    // Predict every collision of the frame up front, then take them in order. An impact only
+    // changes the paths of the spheres hit, so only their collisions are predicted again; the
+    // events predicted for their old paths go stale in the queue.
+    // (sphere i must have been moved to tNow; exclude: a sphere whose collision with sphere i is
+    // already queued)
+    auto predictCollisions = [&](int i, float tNow, int exclude) {
+        ofVec3f x1 = spheres.position(i);
+        ofVec3f v1 = spheres.velocity(i);
+        float r1 = spheres.r[i];
+        const vector<int>& neighbors = sphereGrid.neighbors(i);
+        for (int k = 0; k < neighbors.size(); k++) {
+            int j = neighbors[k];
+            if (j == exclude) {
+                continue;
             }
-            // collide with walls
-            int wallId = sphereCollideWall(sphere1.x, sphere1.v, sphere1.r, 0.f, &dt_c);
-            if (wallId != NONE) {
-                i_c = i;
-                j_c = wallId;
+            float t = dt - tNow;
+            if (spheresCollide(x1, v1, r1, spheres.positionAt(j, tNow), spheres.velocity(j), spheres.r[j], 0.f, &t)) {
+                collisionQueue.push(tNow + t, min(i, j), max(i, j));
             }
         }
+        float t = dt - tNow;
+        int wallId = sphereCollideWall(x1, v1, r1, 0.f, &t);
+        if (wallId != NONE) {
+            collisionQueue.push(tNow + t, i, wallId);
+        }
+    };
+    collisionQueue.clear(numSpheres);
+    for (int i = 0; i < numSpheres; i++) {
+        // pairs are queued from both sides; the second copy is stale once the first is handled.
+        // sleeping spheres hold still, so only the awake ones can run into anything
+        if (!spheres.asleep[i]) {
+            predictCollisions(i, 0.f, -1);
+        }
+    }
 
-        // step all spheres forward until collision
-        if (dt_c > 0.f) {
-            for (int i = 0; i < numSpheres; i++) {
-                RigidBody& body = sphereBodies[i];
-                body.step(dt_c);
-                body.stepW(dt_c);
+    // a sleeping sphere hit hard enough wakes up with its whole island; the spheres woken that
+    // aren't in the collision itself start moving from tNow
+    vector<int> woken;
+    auto wakeIsland = [&](int i, float tNow, int other) {
+        woken.clear();
+        spheres.wake(i, &woken);
+        for (int k = 0; k < woken.size(); k++) {
+            int j = woken[k];
+            if (j != i && j != other) {
+                spheres.advance(j, tNow);
+                sphereGrid.update(j, spheres.position(j), spheres.velocity(j), spheres.r[j], dt - tNow);
+                predictCollisions(j, tNow, -1);
             }
         }
+    };
 
-        if (i_c == -1) {
-            // all collisions (if any) have been resolved
-            break;
+    float dtProcessed = 0.f;
+    int i_c;        // index of sphere that collides
+    int j_c;        // index of other sphere that collides, or wall id that collides
+    float t_c;      // time into the frame of the collision
+    while (collisionQueue.pop(&t_c, &i_c, &j_c)) {
+        float tNow = max(t_c, dtProcessed);
+        spheres.advance(i_c, tNow);
+        if (j_c >= 0) {
+            spheres.advance(j_c, tNow);
         }
 
         RigidBody& sphereBody = sphereBodies[i_c];
@@ -414,15 +524,16 @@ void ofApp::update() {
             ofVec3f n = wallIdToNormal(wallId);
 
             // compute impulse
-            float vn = sphereBody.v.dot(n);
-            ofVec3f impulse = (1.f + e) * abs(vn) * sphereBody.m * n;
+            ofVec3f v1 = spheres.velocity(i_c);
+            float vn = v1.dot(n);
+            ofVec3f impulse = (1.f + e) * abs(vn) / spheres.invMass[i_c] * n;
+
+            // apply impulse to sphere
+            spheres.setVelocity(i_c, v1 + spheres.invMass[i_c] * impulse);
+            syncSphereBody(i_c);
 
             contactPos = sphereBody.x - sphereBody.r * n;
 
-            // apply impulse to sphere
-            sphereBody.P += impulse;
-            sphereBody.v = (sphereBody.P / sphereBody.m);
-            
             // compute tau, SConst for sphere-wall collision
             tau = computeTau(1.f / sphereBody.r, 1.f / sphereBody.m, sphereBody.material.nu, sphereBody.material.E,
                 0.f, 0.f, wallMaterial.nu, wallMaterial.E, vn);
@@ -434,18 +545,33 @@ void ofApp::update() {
         } else {    // sphere-sphere collision
             RigidBody& sphereBody2 = sphereBodies[j_c];
 
-            ofVec3f n = (sphereBody.x - sphereBody2.x).normalized();
-            float vn = (sphereBody2.v - sphereBody.v).dot(n);
-            float J = (1.f + e)*vn / (1.f / sphereBody.m + 1.f / sphereBody2.m);
+            ofVec3f v1 = spheres.velocity(i_c);
+            ofVec3f v2 = spheres.velocity(j_c);
+            ofVec3f n = (spheres.position(i_c) - spheres.position(j_c)).normalized();
+            float vn = (v2 - v1).dot(n);
+
+            // one of them may be asleep (never both: only awake spheres predict collisions). a
+            // sphere settling onto it bounces off as off a wall, so a sleeping pile isn't woken
+            // every frame by what lands on it; a harder hit wakes it
+            if (abs(vn) > SLEEP_SPEED) {
+                if (spheres.asleep[i_c]) {
+                    wakeIsland(i_c, tNow, j_c);
+                } else if (spheres.asleep[j_c]) {
+                    wakeIsland(j_c, tNow, i_c);
+                }
+            }
+            float invMass1 = spheres.asleep[i_c] ? 0.f : spheres.invMass[i_c];
+            float invMass2 = spheres.asleep[j_c] ? 0.f : spheres.invMass[j_c];
+            float J = (1.f + e)*vn / (invMass1 + invMass2);
             ofVec3f impulse = J * n;
 
-            contactPos = sphereBody.x - sphereBody.r * n;
-
             // apply impulse to spheres
-            sphereBody.P += impulse;
-            sphereBody.v = (sphereBody.P / sphereBody.m);
-            sphereBody2.P -= impulse;
-            sphereBody2.v = (sphereBody2.P / sphereBody2.m);
+            spheres.setVelocity(i_c, v1 + invMass1 * impulse);
+            spheres.setVelocity(j_c, v2 - invMass2 * impulse);
+            syncSphereBody(i_c);
+            syncSphereBody(j_c);
+
+            contactPos = sphereBody.x - sphereBody.r * n;
 
             // compute tau, SConst
             tau = computeTau(1.f / sphereBody.r, 1.f / sphereBody.m, sphereBody.material.nu, sphereBody.material.E,
@@ -460,8 +586,27 @@ SConst *= 20.f;
             sphereImpulses[j_c].emplace_back(sphereBody2.closestVertexIndex(contactPos), -impulse);
         }
 
+        // the spheres hit take new paths for the rest of the frame; one still asleep stays put
+        bool iMoves = !spheres.asleep[i_c];
+        bool jMoves = (j_c >= 0 && !spheres.asleep[j_c]);
+        if (iMoves) {
+            collisionQueue.invalidate(i_c);
+            sphereGrid.update(i_c, spheres.position(i_c), spheres.velocity(i_c), spheres.r[i_c], dt - tNow);
+        }
+        if (jMoves) {
+            collisionQueue.invalidate(j_c);
+            sphereGrid.update(j_c, spheres.position(j_c), spheres.velocity(j_c), spheres.r[j_c], dt - tNow);
+        }
+        if (iMoves) {
+            predictCollisions(i_c, tNow, -1);
+        }
+        if (jMoves) {
+            predictCollisions(j_c, tNow, i_c);
+        }
+
         // compute acceleration noise samples for this collision
         // TODO: check for possible overrun of accelAudioSamples array
+        unsigned long long accelAudioStartTime = ofGetElapsedTimeMicros();
         int i = SECONDS_TO_SAMPLES((contactPos - listenPos).length() / 330.f);  // retarded time
         if (i < accelAudioStart) {
             accelAudioStart = i;
@@ -475,20 +620,81 @@ SConst *= 20.f;
         if (i > accelAudioEnd) {
             accelAudioEnd = i;
         }
+        audioMicros += ofGetElapsedTimeMicros() - accelAudioStartTime;
 
-        dtProcessed += dt_c;
+        dtProcessed = tNow;
     }
 
+    // move the spheres through the rest of the frame
     for (int i = 0; i < numSpheres; i++) {
-        RigidBody& body = sphereBodies[i];
+        if (!spheres.asleep[i]) {
+            spheres.advance(i, dt);
+            syncSphereBody(i);
+        }
+    }
 
-        // compute modal amplitues from impulses applied
-        int qsComputedThisBody = body.stepAudio(dt, sphereImpulses[i], 1.f / AUDIO_SAMPLE_RATE, qSums);
-        if (qsComputedThisBody > qsComputed) {
-            qsComputed = qsComputedThisBody;
+    // while the cursor pulls, nothing is at rest
+    if (!attract) {
+        if (spheres.sleepIslands(sphereGrid, SLEEP_SPEED, SLEEP_TIME, dt) > 0) {
+            for (int i = 0; i < numSpheres; i++) {
+                if (spheres.asleep[i]) {
+                    syncSphereBody(i);
+                }
+            }
         }
     }
 
+    // compute modal amplitues from impulses applied. the impulses are projected onto every body's
+    // modes first so the mode scheduler can pick which modes to voice within the budget. then each
+    // body synthesizes into its own scratch buffer (on the worker pool if parallelAudio is set),
+    // and the buffers are summed into qSums in a fixed order so the result is the same no matter
+    // how many threads ran.
+    unsigned long long modalAudioStartTime = ofGetElapsedTimeMicros();
+    vector<RigidBody*> audioBodies;
+    vector<const vector<VertexImpulse>*> audioImpulses;
+    for (int i = 0; i < bodies.size(); i++) {
+        audioBodies.push_back(&bodies[i]);
+        audioImpulses.push_back(&bodyImpulses[i]);
+    }
+    for (int i = 0; i < numSpheres; i++) {
+        audioBodies.push_back(&sphereBodies[i]);
+        audioImpulses.push_back(&sphereImpulses[i]);
+    }
+    const int numAudioBodies = audioBodies.size();
+    const int scratchSize = (int)(dt * AUDIO_SAMPLE_RATE) + 1;
+    audioScratch.resize(numAudioBodies);
+    vector<int> qsComputedPerBody(numAudioBodies, 0);
+    for (int i = 0; i < numAudioBodies; i++) {
+        qsComputedPerBody[i] = audioBodies[i]->prepareAudio(dt, *audioImpulses[i], 1.f / AUDIO_SAMPLE_RATE);
+        assert(qsComputedPerBody[i] <= scratchSize);
+    }
+    modeScheduler.schedule(audioBodies, qualityGovernor);
+    auto synthesizeBody = [&](int i) {
+        vector<float>& scratch = audioScratch[i];
+        scratch.assign(scratchSize, 0.f);
+        audioBodies[i]->synthesizeAudio(qsComputedPerBody[i], &scratch[0]);
+    };
+    if (parallelAudio) {
+        audioWorkers.parallelFor(numAudioBodies, synthesizeBody);
+    } else {
+        for (int i = 0; i < numAudioBodies; i++) {
+            synthesizeBody(i);
+        }
+    }
+    for (int i = 0; i < numAudioBodies; i++) {
+        const vector<float>& scratch = audioScratch[i];
+        for (int k = 0; k < qsComputedPerBody[i]; k++) {
+            qSums[k] += scratch[k];
+        }
+        if (qsComputedPerBody[i] > qsComputed) {
+            qsComputed = qsComputedPerBody[i];
+        }
+    }
+    audioMicros += ofGetElapsedTimeMicros() - modalAudioStartTime;
+
+    // adjust the number of modes per body to keep the audio path within its share of the frame
+    qualityGovernor.update(audioMicros * 1e-6f, dt);
+
 
     // scale qSums to get audio samples
     float audioSamples[CHANNELS * AUDIO_SAMPLE_RATE];   // 1 second worth
@@ -604,19 +810,40 @@ void ofApp::draw(){
         ofSetColor(body.material.color);
         ofPushMatrix();
         const ofMatrix3x3& R = body.R;
-        const ofVec3f& T = body.x;
+        // the shared mesh is unit size; the body's size goes into w (and T is divided by it)
+        // so the rotation, and with it the normals, stay unscaled
+        const float s = body.sizeScale;
+        const ofVec3f T = body.x / s;
         ofMatrix4x4 objToWorld(R.a, R.d, R.g, 0.f,
                                R.b, R.e, R.h, 0.f,
                                R.c, R.f, R.i, 0.f,
-                               T.x, T.y, T.z, 1.f / PIXELS_PER_METER);
+                               T.x, T.y, T.z, 1.f / (s * PIXELS_PER_METER));
         ofLoadMatrix(objToWorld * viewMatrix);
-        body.mesh.draw();
+        body.asset->mesh.draw();
         ofPopMatrix();
     }
 
     ofDisableLighting();
     ofSetColor(255, 255, 255);
-    ofDrawBitmapString(ofToString(ofGetFrameRate()) + "fps", 10, 15);
+    int resonatorsAwake = 0, resonatorWakes = 0, resonatorSleeps = 0;
+    for (RigidBody* bodyPtr : allBodies) {
+        resonatorsAwake += bodyPtr->audioAsleep ? 0 : 1;
+        resonatorWakes += bodyPtr->audioWakeCount;
+        resonatorSleeps += bodyPtr->audioSleepCount;
+    }
+    string qualityChange = "";
+    if (qualityGovernor.framesSinceChange < 60 && qualityGovernor.lastChange != 0.f) {
+        qualityChange = string(qualityGovernor.lastChange > 0.f ? " (+" : " (") +
+                        ofToString((int)roundf(100.f * qualityGovernor.lastChange)) + "%)";
+    }
+    ofDrawBitmapString(ofToString(ofGetFrameRate()) + "fps" +
+                       "  audio load: " + ofToString((int)roundf(100.f * qualityGovernor.load)) + "%" +
+                       "  quality: " + ofToString((int)roundf(100.f * qualityGovernor.quality)) + "%" + qualityChange +
+                       (qualityGovernor.enabled ? "" : " (fixed)"), 10, 15);
+    ofDrawBitmapString("resonators awake: " + ofToString(resonatorsAwake) + "/" + ofToString(allBodies.size()) +
+                       "  wakes: " + ofToString(resonatorWakes) + "  sleeps: " + ofToString(resonatorSleeps), 10, 30);
+    ofDrawBitmapString("modes voiced: " + ofToString(modeScheduler.voicedModes) + "/" + ofToString(modeScheduler.audibleModes) +
+                       "  budget: " + (modeScheduler.enabled ? ofToString(modeScheduler.budget) : string("off")), 10, 45);
 }
 
 //--------------------------------------------------------------
@@ -707,6 +934,26 @@ void ofApp::keyPressed(int key){
         accelAudioScale *= 1.1f;
         printf("accelAudioScale = %f\n", accelAudioScale);
         break;
+    case '[':
+        modeScheduler.budget = max(modeScheduler.budget / 2, 1);
+        printf("mode budget = %d\n", modeScheduler.budget);
+        break;
+    case ']':
+        modeScheduler.budget *= 2;
+        printf("mode budget = %d\n", modeScheduler.budget);
+        break;
+    case 'b':
+        modeScheduler.enabled = !modeScheduler.enabled;
+        printf("mode budget: %s\n", modeScheduler.enabled ? "on" : "off");
+        break;
+    case 'g':
+        qualityGovernor.enabled = !qualityGovernor.enabled;
+        printf("quality governor: %s\n", qualityGovernor.enabled ? "on" : "off");
+        break;
+    case 'p':
+        parallelAudio = !parallelAudio;
+        printf("modal synthesis on %d worker threads: %s\n", audioWorkers.numWorkers(), parallelAudio ? "on" : "off");
+        break;
     default:
         break;
     }
@@ -725,21 +972,34 @@ void ofApp::keyReleased(int key){
     switch (key) {
     case OF_KEY_LEFT:
         gravity = ofVec3f(-GRAVITY_MAG, 0.f, 0.f);
+        wakeAll();
         break;
     case OF_KEY_RIGHT:
         gravity = ofVec3f(GRAVITY_MAG, 0.f, 0.f);
+        wakeAll();
         break;
     case OF_KEY_UP:
         gravity = ofVec3f(0.f, -GRAVITY_MAG, 0.f);
+        wakeAll();
         break;
     case OF_KEY_DOWN:
         gravity = ofVec3f(0.f, GRAVITY_MAG, 0.f);
+        wakeAll();
         break;
     default:
         break;
     }
 }
 
+// gravity turned or the cursor started pulling: nothing that was at rest still is
+void ofApp::wakeAll() {
+    for (RigidBody& body : bodies) {
+        body.asleep = false;
+        body.stillTime = 0.f;
+    }
+    spheres.wakeAll();
+}
+
 //--------------------------------------------------------------
 void ofApp::mouseMoved(int x, int y ){
 
@@ -753,6 +1013,7 @@ void ofApp::mouseDragged(int x, int y, int button){
 //--------------------------------------------------------------
 void ofApp::mousePressed(int x, int y, int button){
     attract = true;
+    wakeAll();
     attractPos = ofVec3f(x / PIXELS_PER_METER, y / PIXELS_PER_METER, 0.5f * (BOX_ZMIN + BOX_ZMAX));
 }
 
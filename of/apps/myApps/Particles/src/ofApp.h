@@ -5,6 +5,14 @@
 #include "ofMain.h"
 #include "RingBuffer.h"
 #include "RigidBody.h"
+#include "ContactSolver.h"
+#include "SphereGrid.h"
+#include "CollisionQueue.h"
+#include "SphereParticles.h"
+#include "BodyIntegrator.h"
+#include "WorkerPool.h"
+#include "ModeScheduler.h"
+#include "QualityGovernor.h"
 
 #define PIXELS_PER_METER 800.0
 
@@ -46,6 +54,8 @@ private:
     int particleCollideWall(const ofVec3f& p, const ofVec3f& v, float tMin, float* t);
     int sphereCollideWall(const ofVec3f& p, const ofVec3f& v, float r, float tMin, float* t);
 
+    void wakeAll();
+
 private:
     ofLight pointLight;
     ofPlanePrimitive leftWall, rightWall, bottomWall, topWall, backWall;
@@ -53,8 +63,12 @@ private:
     ofVec3f pMin, pMax;                 // scene bounds
 
     vector<RigidBody> bodies;
-    vector<RigidBody> sphereBodies;
+    vector<RigidBody> sphereBodies;     // draw and sound the spheres
+    SphereParticles spheres;            // move them; sphereBodies[i] is spheres' particle i
     vector<RigidBody*> allBodies;
+    BodyIntegrator bodyIntegrator;      // steps the bodies after their wall contacts
+    SphereGrid sphereGrid;              // which spheres can meet this frame
+    CollisionQueue collisionQueue;      // when they do
 
     ofVec3f gravity;                    // acceleration due to gravity
     
@@ -73,4 +87,14 @@ private:
 
     float qScale;
     float accelAudioScale;
+
+    WorkerPool audioWorkers;            // runs stepAudio for several bodies at once
+    bool parallelAudio;
+    vector<vector<float>> audioScratch; // per-body modal sums, reduced into the output in body order
+
+    ModeScheduler modeScheduler;        // scene-wide budget of voiced modes
+    QualityGovernor qualityGovernor;    // scales modes per body with the measured audio load
+
+    bool firstFrameLogged;              // startup timing; modes keep loading after the first frame
+    bool allModesLoadedLogged;
 };
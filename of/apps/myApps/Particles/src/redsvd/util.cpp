@@ -17,8 +17,9 @@
  *      software without specific prior written permission.
  */
 
+#define _USE_MATH_DEFINES   // M_PI on MSVC
 #include <iostream>
-#include <sys/time.h>
+#include <chrono>
 
 #include "util.hpp"
 
@@ -30,9 +31,7 @@ namespace REDSVD {
 const float SVD_EPS = 0.0001f;
 
 double Util::getSec(){
-  timeval tv;
-  gettimeofday(&tv, NULL);
-  return tv.tv_sec + (double)tv.tv_usec*1e-6;
+  return chrono::duration<double>(chrono::high_resolution_clock::now().time_since_epoch()).count();
 }
 
 void Util::sampleTwoGaussian(float& f1, float& f2){